@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "CaseFold.h"
+
+// The letters of Latin Extended-B that don't come in neat pairs. 
+// Many of them fold into the IPA Extensions.
+static const uint32 kLatinFolds[][2] = {
+	{ 0x181, 0x253 }, { 0x182, 0x183 }, { 0x184, 0x185 }, { 0x186, 0x254 },
+	{ 0x187, 0x188 }, { 0x189, 0x256 }, { 0x18A, 0x257 }, { 0x18B, 0x18C },
+	{ 0x18E, 0x1DD }, { 0x18F, 0x259 }, { 0x190, 0x25B }, { 0x191, 0x192 },
+	{ 0x193, 0x260 }, { 0x194, 0x263 }, { 0x196, 0x269 }, { 0x197, 0x268 },
+	{ 0x198, 0x199 }, { 0x19C, 0x26F }, { 0x19D, 0x272 }, { 0x19F, 0x275 },
+	{ 0x1A0, 0x1A1 }, { 0x1A2, 0x1A3 }, { 0x1A4, 0x1A5 }, { 0x1A6, 0x280 },
+	{ 0x1A7, 0x1A8 }, { 0x1A9, 0x283 }, { 0x1AC, 0x1AD }, { 0x1AE, 0x288 },
+	{ 0x1AF, 0x1B0 }, { 0x1B1, 0x28A }, { 0x1B2, 0x28B }, { 0x1B3, 0x1B4 },
+	{ 0x1B5, 0x1B6 }, { 0x1B7, 0x292 }, { 0x1B8, 0x1B9 }, { 0x1BC, 0x1BD },
+	{ 0x1C4, 0x1C6 }, { 0x1C5, 0x1C6 }, { 0x1C7, 0x1C9 }, { 0x1C8, 0x1C9 },
+	{ 0x1CA, 0x1CC }, { 0x1CB, 0x1CC }, { 0x1F1, 0x1F3 }, { 0x1F2, 0x1F3 },
+	{ 0x1F4, 0x1F5 }, { 0x1F6, 0x195 }, { 0x1F7, 0x1BF }, { 0x220, 0x19E },
+	{ 0x23B, 0x23C }, { 0x23D, 0x19A }, { 0x241, 0x242 }, { 0x243, 0x180 },
+	{ 0x244, 0x289 }, { 0x245, 0x28C }
+};
+
+// The Greek letters and symbols that don't follow a pattern.
+static const uint32 kGreekFolds[][2] = {
+	{ 0x370, 0x371 }, { 0x372, 0x373 }, { 0x376, 0x377 }, { 0x37F, 0x3F3 },
+	{ 0x386, 0x3AC }, { 0x38C, 0x3CC }, { 0x3C2, 0x3C3 }, { 0x3CF, 0x3D7 },
+	{ 0x3D0, 0x3B2 }, { 0x3D1, 0x3B8 }, { 0x3D5, 0x3C6 }, { 0x3D6, 0x3C0 }, 
+	{ 0x3F0, 0x3BA }, { 0x3F1, 0x3C1 }, { 0x3F4, 0x3B8 }, { 0x3F5, 0x3B5 },
+	{ 0x3F7, 0x3F8 }, { 0x3F9, 0x3F2 }, { 0x3FA, 0x3FB }, { 0x3FD, 0x37B },
+	{ 0x3FE, 0x37C }, { 0x3FF, 0x37D }
+};
+
+
+uint32 fold_char(uint32 c)
+{
+	if (c < 0x80)
+		return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+
+	// Latin-1 and Latin Extended-A. Most of the latter come in 
+	// pairs, with the uppercase letter first.
+
+	if (c < 0x180) {
+		if (c == 0xB5)
+			return 0x3BC;
+		if (c >= 0xC0 && c <= 0xDE && c != 0xD7)
+			return c + 0x20;
+		if (c == 0x178)
+			return 0xFF;
+		if ((c >= 0x100 && c <= 0x12F) || (c >= 0x132 && c <= 0x137)
+				|| (c >= 0x14A && c <= 0x177))
+			return c | 1;
+		if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E))
+			return (c & 1) ? c + 1 : c;
+		return c;
+	}
+
+	// Latin Extended-B. The letters with a caron and the ones after
+	// them come in pairs; the rest are all over the place.
+
+	if (c < 0x250) {
+		if (c >= 0x1CD && c <= 0x1DC)
+			return (c & 1) ? c + 1 : c;
+		if ((c >= 0x1DE && c <= 0x1EF) || (c >= 0x1F8 && c <= 0x21F)
+				|| (c >= 0x222 && c <= 0x233) || (c >= 0x246 && c <= 0x24F))
+			return c | 1;
+
+		for (uint32 t = 0; t < sizeof(kLatinFolds) / sizeof(kLatinFolds[0]); 
+				++t) {
+			if (kLatinFolds[t][0] == c)
+				return kLatinFolds[t][1];
+		}
+		return c;
+	}
+
+	// Greek.
+
+	if (c >= 0x370 && c < 0x400) {
+		if (c >= 0x388 && c <= 0x38A)
+			return c + 37;
+		if (c == 0x38E || c == 0x38F)
+			return c + 63;
+		if (c >= 0x391 && c <= 0x3AB && c != 0x3A2)
+			return c + 0x20;
+		if (c >= 0x3D8 && c <= 0x3EF)
+			return c | 1;
+
+		for (uint32 t = 0; t < sizeof(kGreekFolds) / sizeof(kGreekFolds[0]); 
+				++t) {
+			if (kGreekFolds[t][0] == c)
+				return kGreekFolds[t][1];
+		}
+		return c;
+	}
+
+	// Cyrillic.
+
+	if (c >= 0x400 && c < 0x530) {
+		if (c < 0x410)
+			return c + 0x50;
+		if (c < 0x430)
+			return c + 0x20;
+		if ((c >= 0x460 && c <= 0x481) || (c >= 0x48A && c <= 0x4BF)
+				|| c >= 0x4D0)
+			return c | 1;
+		if (c == 0x4C0)
+			return 0x4CF;
+		if (c >= 0x4C1 && c <= 0x4CE)
+			return (c & 1) ? c + 1 : c;
+		return c;
+	}
+
+	// Latin Extended Additional, which has Vietnamese.
+
+	if ((c >= 0x1E00 && c <= 0x1E95) || (c >= 0x1EA0 && c <= 0x1EFF))
+		return c | 1;
+	if (c == 0x1E9B)
+		return 0x1E61;
+
+	return c;
+}
+
+
+int32 decode_utf8(const uchar *text, const uchar *end, uint32 *c)
+{
+	uchar first = text[0];
+	if (first < 0x80) {
+		*c = first;
+		return 1;
+	}
+
+	int32 length;
+	uint32 value;
+	if (first >= 0xC2 && first <= 0xDF) {
+		length = 2;
+		value = first & 0x1F;
+	} else if (first >= 0xE0 && first <= 0xEF) {
+		length = 3;
+		value = first & 0x0F;
+	} else if (first >= 0xF0 && first <= 0xF4) {
+		length = 4;
+		value = first & 0x07;
+	} else
+		return 0;
+
+	if (end - text < length)
+		return 0;
+
+	for (int32 t = 1; t < length; ++t) {
+		if ((text[t] & 0xC0) != 0x80)
+			return 0;
+		value = (value << 6) | (text[t] & 0x3F);
+	}
+
+	*c = value;
+	return length;
+}
+
+
+int32 encode_utf8(uint32 c, uchar *dest)
+{
+	if (c < 0x80) {
+		dest[0] = c;
+		return 1;
+	}
+	if (c < 0x800) {
+		dest[0] = 0xC0 | (c >> 6);
+		dest[1] = 0x80 | (c & 0x3F);
+		return 2;
+	}
+	if (c < 0x10000) {
+		dest[0] = 0xE0 | (c >> 12);
+		dest[1] = 0x80 | ((c >> 6) & 0x3F);
+		dest[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+	dest[0] = 0xF0 | (c >> 18);
+	dest[1] = 0x80 | ((c >> 12) & 0x3F);
+	dest[2] = 0x80 | ((c >> 6) & 0x3F);
+	dest[3] = 0x80 | (c & 0x3F);
+	return 4;
+}
+
+
+int32 fold_utf8(const uchar *text, const uchar *end, uchar *dest)
+{
+	uint32 c;
+	int32 length = decode_utf8(text, end, &c);
+	if (length == 0) {
+		dest[0] = text[0];
+		return 1;
+	}
+
+	return encode_utf8(fold_char(c), dest);
+}
+
+
+int32 case_variants(uint32 c, uint32 *variants)
+{
+	// There are few enough characters that we can simply try 
+	// all of them that have the same length.
+
+	uint32 folded = fold_char(c);
+	uint32 first;
+	uint32 last;
+	if (c < 0x80) {
+		first = 0;
+		last = 0x80;
+	} else if (c < 0x800) {
+		first = 0x80;
+		last = 0x800;
+	} else if (c >= 0x1E00 && c < 0x1F00) {
+		first = 0x1E00;
+		last = 0x1F00;
+	} else {
+		variants[0] = c;
+		return 1;
+	}
+
+	int32 count = 0;
+	for (uint32 other = first; other < last 
+			&& count < MAX_CASE_VARIANTS; ++other) {
+		if (fold_char(other) == folded)
+			variants[count++] = other;
+	}
+	return count;
+}
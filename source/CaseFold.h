@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __CASE_FOLD_H__
+#define __CASE_FOLD_H__
+
+#include <SupportDefs.h>
+
+// Simple Unicode case folding for UTF-8 text. We cover the scripts 
+// where both cases take up the same number of bytes: ASCII, Latin-1,
+// Latin Extended-A and B, Latin Extended Additional, Greek and 
+// Cyrillic. That way, folding never moves text around, and a match
+// in folded text is at the same place in the original.
+
+// The most case variants one character can have.
+#define MAX_CASE_VARIANTS 4
+
+// Returns the folded (mostly lowercase) form of a character.
+uint32 fold_char(uint32 c);
+
+// Decodes the character at "text", and returns its length in bytes, 
+// or 0 if it is not valid UTF-8 or runs past "end".
+int32 decode_utf8(const uchar *text, const uchar *end, uint32 *c);
+
+// Encodes a character, and returns its length in bytes.
+int32 encode_utf8(uint32 c, uchar *dest);
+
+// Folds the character at "text" into "dest", and returns its length, 
+// which is the same for both. Bytes that are not valid UTF-8 are 
+// copied one at a time.
+int32 fold_utf8(const uchar *text, const uchar *end, uchar *dest);
+
+// Fills "variants" with all the characters that fold the same as "c",
+// and have the same length in UTF-8, including "c" itself. Returns
+// how many there are.
+int32 case_variants(uint32 c, uint32 *variants);
+
+#endif // __CASE_FOLD_H__
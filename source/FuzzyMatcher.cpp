@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+
+#include "CaseFold.h"
+#include "FuzzyMatcher.h"
+
+// Bytes that aren't valid UTF-8 are characters of their own, 
+// which never fold and never match anything else.
+#define BAD_BYTE_BASE 0x110000
+
+
+FuzzyMatcher::FuzzyMatcher(const char *pattern, int32 maxErrors,
+	bool caseSensitive, bool utf8)
+{
+	fUtf8 = utf8;
+	fBytes = strlen(pattern);
+	fMaxErrors = maxErrors;
+	if (fMaxErrors < 0)
+		fMaxErrors = 0;
+	if (fMaxErrors > MAX_FUZZY_ERRORS)
+		fMaxErrors = MAX_FUZZY_ERRORS;
+
+	memset(fMasks, 0, sizeof(fMasks));
+	memset(fReverse, 0, sizeof(fReverse));
+	memset(fTable, 0, sizeof(fTable));
+	fFinal = 0;
+
+	// Each character of the pattern takes one bit of the states,
+	// however many bytes it has.
+
+	uint32 chars[65];
+	fLength = 0;
+
+	const uchar *src = (const uchar*) pattern;
+	const uchar *end = src + fBytes;
+	while (src != end && fLength <= 64)
+		chars[fLength++] = NextChar(&src, end, false);
+
+	if (InitCheck() != B_OK)
+		return;
+
+	// When ignoring case, every position also takes the other cases
+	// of its character.
+
+	for (int32 pos = 0; pos < fLength; ++pos) {
+		uint32 c = chars[pos];
+		if (caseSensitive || c >= BAD_BYTE_BASE) {
+			AddChar(pos, c);
+			continue;
+		}
+
+		if (!fUtf8 || c < 0x80) {
+			AddChar(pos, c);
+			if (c >= 'A' && c <= 'Z')
+				AddChar(pos, c + 'a' - 'A');
+			else if (c >= 'a' && c <= 'z')
+				AddChar(pos, c - ('a' - 'A'));
+			continue;
+		}
+
+		uint32 variants[MAX_CASE_VARIANTS];
+		int32 count = case_variants(c, variants);
+		for (int32 t = 0; t < count; ++t)
+			AddChar(pos, variants[t]);
+	}
+
+	fFinal = (uint64) 1 << (fLength - 1);
+
+	// A line break never matches, so no match spans lines.
+	fMasks['\n'] = 0;
+	fReverse['\n'] = 0;
+}
+
+
+FuzzyMatcher::~FuzzyMatcher()
+{
+}
+
+
+status_t FuzzyMatcher::InitCheck() const
+{
+	if (fLength > 64 || fLength <= fMaxErrors)
+		return B_BAD_VALUE;
+	return B_OK;
+}
+
+
+const char *FuzzyMatcher::Find(const char *start, const char *end,
+	const char **matchEnd, int32 *distance) const
+{
+	const uchar *text = (const uchar*) start;
+	const uchar *found = Run(false, text, (const uchar*) end, fMaxErrors,
+		distance);
+	if (found == NULL)
+		return NULL;
+
+	// Bitap only tells where a match ends. To find where it starts,
+	// we run the reversed pattern back from there, with no more 
+	// typos than we just found.
+
+	const uchar *stop = found - MaxLength();
+	if (stop < text)
+		stop = text;
+
+	int32 reverseDistance;
+	const uchar *first = Run(true, found - 1, stop - 1, *distance,
+		&reverseDistance);
+
+	*matchEnd = (const char*) found;
+	return (const char*) ((first != NULL) ? first + 1 : stop);
+}
+
+
+uint32 FuzzyMatcher::NextChar(const uchar **text, const uchar *stop,
+	bool backward) const
+{
+	const uchar *pos = *text;
+	uint32 c = *pos;
+
+	if (!backward) {
+		int32 length = 1;
+		if (c >= 0x80 && fUtf8) {
+			length = decode_utf8(pos, stop, &c);
+			if (length == 0) {
+				c = BAD_BYTE_BASE + *pos;
+				length = 1;
+			}
+		}
+		*text = pos + length;
+		return c;
+	}
+
+	// Going back, "pos" is the last byte of the character, and 
+	// "stop" is right before the first byte we may look at.
+
+	if (c >= 0x80 && fUtf8) {
+		const uchar *lead = pos;
+		while (lead - 1 > stop && pos - lead < 3 && (*lead & 0xC0) == 0x80)
+			--lead;
+
+		if (decode_utf8(lead, pos + 1, &c) == pos + 1 - lead) {
+			*text = lead - 1;
+			return c;
+		}
+		c = BAD_BYTE_BASE + *pos;
+	}
+
+	*text = pos - 1;
+	return c;
+}
+
+
+const uchar *FuzzyMatcher::Run(bool backward, const uchar *text,
+	const uchar *stop, int32 maxErrors, int32 *distance) const
+{
+	// Bit j of state[d] is set if the first j + 1 characters of the 
+	// pattern match the text up to here with at most d typos. Each 
+	// character of the text updates all the states with a handful of
+	// shifts and ORs.
+
+	uint64 state[MAX_FUZZY_ERRORS + 1];
+	for (int32 d = 0; d <= maxErrors; ++d)
+		state[d] = ((uint64) 1 << d) - 1;
+
+	const uint64 *masks = backward ? fReverse : fMasks;
+	const uchar *found = NULL;
+	int32 best = 0;
+	int32 ahead = 0;
+
+	while (text != stop) {
+		uint32 c = NextChar(&text, stop, backward);
+
+		if (c == '\n') {
+			if (found != NULL)
+				break;
+			for (int32 d = 0; d <= maxErrors; ++d)
+				state[d] = ((uint64) 1 << d) - 1;
+			continue;
+		}
+
+		uint64 mask;
+		if (c < 0x80)
+			mask = masks[c];
+		else {
+			const Entry &entry = fTable[Slot(c)];
+			mask = backward ? entry.reverse : entry.forward;
+		}
+
+		uint64 before = state[0];
+		state[0] = ((state[0] << 1) | 1) & mask;
+
+		for (int32 d = 1; d <= maxErrors; ++d) {
+			uint64 old = state[d];
+
+			// Matched, changed, added or left out a character.
+			state[d] = (((old << 1) | 1) & mask) 
+				| (before << 1) | before | (state[d - 1] << 1) | 1;
+
+			before = old;
+		}
+
+		// Each state holds all the bits of the ones with fewer typos,
+		// so usually the last one tells us there is nothing here.
+
+		if ((state[maxErrors] & fFinal) == 0) {
+			if (found != NULL && ++ahead >= best)
+				break;
+			continue;
+		}
+
+		int32 d = 0;
+		while ((state[d] & fFinal) == 0)
+			++d;
+
+		if (found == NULL || d < best) {
+			found = text;
+			best = d;
+			ahead = 0;
+		} else
+			++ahead;
+
+		// A match with typos may be followed by a better match of 
+		// the same text a few characters later; we look that far ahead.
+
+		if (ahead >= best)
+			break;
+	}
+
+	*distance = best;
+	return found;
+}
+
+
+void FuzzyMatcher::AddChar(int32 pos, uint32 c)
+{
+	uint64 forward = (uint64) 1 << pos;
+	uint64 reverse = (uint64) 1 << (fLength - 1 - pos);
+
+	if (c < 0x80) {
+		fMasks[c] |= forward;
+		fReverse[c] |= reverse;
+		return;
+	}
+
+	Entry &entry = fTable[Slot(c)];
+	entry.c = c;
+	entry.forward |= forward;
+	entry.reverse |= reverse;
+}
+
+
+int32 FuzzyMatcher::Slot(uint32 c) const
+{
+	// The table never fills up, so this always ends.
+	uint32 slot = (c * 2654435761U) & (FUZZY_TABLE_SIZE - 1);
+	while (fTable[slot].c != 0 && fTable[slot].c != c)
+		slot = (slot + 1) & (FUZZY_TABLE_SIZE - 1);
+	return slot;
+}
+
+
+int32 FuzzyMatcher::Length() const
+{
+	return fBytes;
+}
+
+
+int32 FuzzyMatcher::MaxLength() const
+{
+	// Every typo may add a character of up to four bytes.
+	return fBytes + 4 * fMaxErrors;
+}
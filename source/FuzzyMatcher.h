@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __FUZZY_MATCHER_H__
+#define __FUZZY_MATCHER_H__
+
+#include <SupportDefs.h>
+
+// The most typos we allow in a fuzzy match.
+#define MAX_FUZZY_ERRORS 3
+
+// How many characters of the pattern outside ASCII we can look up. 
+// This must be a power of two, and well over 64 * MAX_CASE_VARIANTS.
+#define FUZZY_TABLE_SIZE 512
+
+// Finds a literal string with up to a few typos (characters that 
+// were left out, added, or changed), using the bit-parallel Bitap 
+// algorithm of Wu and Manber. Patterns can be up to 64 characters 
+// long, and typos are counted in characters, not bytes. Matches 
+// never span lines.
+class FuzzyMatcher {
+	public:
+	
+		// If the text isn't UTF-8, pass false for "utf8"; every byte
+		// is then a character, and we only fold ASCII letters.
+		FuzzyMatcher(const char *pattern, int32 maxErrors, 
+			bool caseSensitive, bool utf8 = true);
+		virtual ~FuzzyMatcher();
+		
+		// Returns B_BAD_VALUE if the pattern is too long, or so
+		// short that it would match anything.
+		status_t InitCheck() const;
+		
+		// Returns the first match between "start" and "end", or NULL,
+		// and sets "matchEnd" to where it ends and "distance" to the 
+		// number of typos.
+		const char *Find(const char *start, const char *end,
+			const char **matchEnd, int32 *distance) const;
+		
+		// Returns the length of the pattern in bytes.
+		int32 Length() const;
+		
+		// The longest a match can be, in bytes.
+		int32 MaxLength() const;
+	
+	private:
+	
+		struct Entry {
+			uint32 c;
+			uint64 forward;
+			uint64 reverse;
+		};
+		
+		// Lets "c" match at position "pos" of the pattern.
+		void AddChar(int32 pos, uint32 c);
+		
+		// Where "c" is in fTable, or the empty slot where it would go.
+		int32 Slot(uint32 c) const;
+		
+		// Reads the character at "text", or the one that ends there
+		// when going back, and moves "text" past it. 
+		uint32 NextChar(const uchar **text, const uchar *stop, 
+			bool backward) const;
+		
+		// Runs the automaton over the text, forward or backward, and
+		// returns the first position where the pattern matches with 
+		// at most "maxErrors" typos, or NULL. Sets "distance" to the 
+		// number of typos there.
+		const uchar *Run(bool backward, const uchar *text, 
+			const uchar *stop, int32 maxErrors, int32 *distance) const;
+		
+		// The positions in the pattern where each ASCII character 
+		// occurs, front to back and back to front.
+		uint64 fMasks[128];
+		uint64 fReverse[128];
+		
+		// The same for the other characters, as a hash table.
+		Entry fTable[FUZZY_TABLE_SIZE];
+		
+		// The bit of the last position in the pattern.
+		uint64 fFinal;
+		
+		// The length of the pattern in characters and in bytes.
+		int32 fLength;
+		int32 fBytes;
+		
+		int32 fMaxErrors;
+		bool fUtf8;
+};
+
+#endif // __FUZZY_MATCHER_H__
@@ -20,28 +20,529 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include <Path.h>
-#include <Entry.h>
+
+#include <InterfaceKit.h>
+
+#include <stdio.h>
+
 #include "GrepListView.h"
 
-class ResultItem : public BStringItem {
-	public:
+// The space for the triangle that expands and collapses a file.
+#define LATCH_WIDTH 16
 
-		ResultItem(entry_ref &ref) : BStringItem("", 0, false)
-		{
-			this->ref = ref;
-			BEntry entry(&ref);
-			BPath path(&entry);
-			SetText(path.Path()); 
-		}
-	
-		entry_ref ref;
-};
+
+// Returns the color halfway between "a" and "b".
+static rgb_color blend_colors(rgb_color a, rgb_color b)
+{
+	rgb_color color;
+	color.red = (a.red + b.red) / 2;
+	color.green = (a.green + b.green) / 2;
+	color.blue = (a.blue + b.blue) / 2;
+	color.alpha = 255;
+	return color;
+}
+
+
+// Returns black or white, whichever is easier to read on "color".
+static rgb_color contrast_color(rgb_color color)
+{
+	rgb_color black = { 0, 0, 0, 255 };
+	rgb_color white = { 255, 255, 255, 255 };
+	int32 brightness = (color.red * 299 + color.green * 587 
+		+ color.blue * 114) / 1000;
+	return (brightness >= 128) ? black : white;
+}
 
 
 GrepListView::GrepListView()
-	: BOutlineListView(BRect(0, 0, 40, 80), "SearchResults", 
-		B_MULTIPLE_SELECTION_LIST, B_FOLLOW_ALL_SIDES, B_WILL_DRAW|B_NAVIGABLE)
+	: BView(BRect(0, 0, 40, 80), "SearchResults", 
+		B_FOLLOW_ALL_SIDES, B_WILL_DRAW | B_NAVIGABLE | B_FRAME_EVENTS)
+{
+	fStore = new ResultStore();
+	fInvocationMessage = NULL;
+	fRowHeight = 16;
+	fBaseline = 12;
+	fWidestRow = 0;
+	fLastRowCount = 0;
+	fAnchorFile = -1;
+	fAnchorLine = -1;
+}
+
+
+GrepListView::~GrepListView()
+{
+	delete fStore;
+	delete fInvocationMessage;
+}
+
+
+void GrepListView::AttachedToWindow()
+{
+	BView::AttachedToWindow();
+
+	SetViewColor(ui_color(B_LIST_BACKGROUND_COLOR));
+
+	font_height height;
+	GetFontHeight(&height);
+	fRowHeight = (float) (int32) (height.ascent + height.descent 
+		+ height.leading + 3);
+	fBaseline = (float) (int32) (height.ascent + 2);
+
+	UpdateScrollBars();
+}
+
+
+void GrepListView::Draw(BRect updateRect)
+{
+	int32 row = (int32) (updateRect.top / fRowHeight);
+	int32 file, line;
+
+	if (!fStore->GetRow(row, &file, &line))
+		return;
+
+	// Only the rows that need drawing cost us anything, no
+	// matter how many results there are.
+
+	BRect bounds = Bounds();
+	do {
+		BRect frame(bounds.left, row * fRowHeight, 
+			bounds.right, (row + 1) * fRowHeight - 1);
+		if (frame.top > updateRect.bottom)
+			break;
+
+		DrawRow(frame, file, line);
+		++row;
+	} while (fStore->NextRow(&file, &line));
+}
+
+
+void GrepListView::DrawRow(BRect frame, int32 file, int32 line)
+{
+	// We follow the colors of the user's list views, so 
+	// we look right with a dark theme too.
+
+	rgb_color background = ui_color(B_LIST_BACKGROUND_COLOR);
+	rgb_color text = ui_color(B_LIST_ITEM_TEXT_COLOR);
+	rgb_color highlight = ui_color(B_CONTROL_HIGHLIGHT_COLOR);
+
+	if (fStore->IsSelected(file, line)) {
+		background = ui_color(B_LIST_SELECTED_BACKGROUND_COLOR);
+		text = ui_color(B_LIST_SELECTED_ITEM_TEXT_COLOR);
+		highlight = blend_colors(highlight, background);
+	}
+
+	SetHighColor(background);
+	FillRect(frame);
+	SetLowColor(background);
+	SetHighColor(text);
+
+	BPoint pen(frame.left, frame.top + fBaseline);
+
+	if (line < 0) {
+		const char *text = fStore->FileLabel(file);
+		pen.x += LATCH_WIDTH;
+		DrawString(text, pen);
+		pen.x += StringWidth(text);
+
+		if (fStore->CountLines(file) > 0) {
+			float left = frame.left + 4;
+			float top = frame.top + (fRowHeight - 8) / 2;
+
+			if (fStore->IsExpanded(file)) {
+				FillTriangle(BPoint(left, top + 2), BPoint(left + 8, top + 2), 
+					BPoint(left + 4, top + 6));
+			} else {
+				FillTriangle(BPoint(left + 2, top), BPoint(left + 2, top + 8), 
+					BPoint(left + 6, top + 4));
+			}
+		}
+	} else {
+		pen.x += 2 * LATCH_WIDTH;
+
+		// The line number is not part of the text, like it 
+		// would have been with grep -n.
+
+		// Context lines are grayed out, and have a '-' 
+		// after their number, like grep shows them. Lines 
+		// that matched with typos say how many.
+
+		bool context = fStore->IsContext(file, line);
+		if (context) {
+			text = blend_colors(text, background);
+			SetHighColor(text);
+		}
+
+		int32 number = fStore->LineNumber(file, line);
+		if (number > 0) {
+			char prefix[32];
+			int32 distance = fStore->Distance(file, line);
+			if (distance > 0)
+				sprintf(prefix, "%ld~%ld:", number, distance);
+			else
+				sprintf(prefix, "%ld%c", number, context ? '-' : ':');
+			DrawString(prefix, pen);
+			pen.x += StringWidth(prefix);
+		}
+
+		int32 length;
+		const char *lineText = fStore->LineText(file, line, &length);
+
+		const MatchRange *matches;
+		int32 matchCount = fStore->GetMatches(file, line, &matches);
+		DrawLineText(frame, pen, lineText, length, matches, matchCount, 
+			background, text, highlight);
+	}
+
+	// We only learn how wide the rows are when we draw them.
+	float width = pen.x + 4;
+	if (width > fWidestRow) {
+		fWidestRow = width;
+		UpdateScrollBars();
+	}
+}
+
+
+void GrepListView::DrawLineText(BRect frame, BPoint &pen, const char *text,
+	int32 length, const MatchRange *matches, int32 matchCount, 
+	rgb_color background, rgb_color color, rgb_color highlight)
+{
+	// The workers told us where the matches are, so we 
+	// only have to paint behind them.
+
+	int32 pos = 0;
+	for (int32 t = 0; t < matchCount; ++t) {
+		int32 start = matches[t].start;
+		int32 end = start + matches[t].length;
+
+		// The file may have changed since it was searched.
+		if (start < pos || end > length)
+			break;
+
+		if (start > pos) {
+			DrawString(text + pos, start - pos, pen);
+			pen.x += StringWidth(text + pos, start - pos);
+		}
+
+		float width = StringWidth(text + start, end - start);
+		SetHighColor(highlight);
+		FillRect(BRect(pen.x, frame.top, pen.x + width - 1, frame.bottom));
+		SetLowColor(highlight);
+		SetHighColor(contrast_color(highlight));
+		DrawString(text + start, end - start, pen);
+		SetLowColor(background);
+		SetHighColor(color);
+		pen.x += width;
+
+		pos = end;
+	}
+
+	DrawString(text + pos, length - pos, pen);
+	pen.x += StringWidth(text + pos, length - pos);
+}
+
+
+void GrepListView::FrameResized(float width, float height)
+{
+	BView::FrameResized(width, height);
+	UpdateScrollBars();
+}
+
+
+void GrepListView::MouseDown(BPoint where)
+{
+	MakeFocus(true);
+
+	int32 clicks = 1;
+	Window()->CurrentMessage()->FindInt32("clicks", &clicks);
+	uint32 mods = modifiers();
+
+	int32 row = (int32) (where.y / fRowHeight);
+	int32 file, line;
+
+	if (!fStore->GetRow(row, &file, &line)) {
+		fStore->DeselectAll();
+		Invalidate();
+		return;
+	}
+
+	if (line < 0 && where.x < Bounds().left + LATCH_WIDTH 
+		&& fStore->CountLines(file) > 0) {
+		ToggleExpanded(file);
+		return;
+	}
+
+	int32 anchor = fStore->RowOf(fAnchorFile, fAnchorLine);
+
+	if ((mods & B_SHIFT_KEY) != 0 && anchor >= 0) {
+		fStore->DeselectAll();
+		SelectRange(anchor, row);
+		Invalidate();
+		return;
+	}
+
+	if ((mods & B_COMMAND_KEY) != 0) {
+		fStore->SetSelected(file, line, !fStore->IsSelected(file, line));
+	} else {
+		if (clicks == 2 && fStore->IsSelected(file, line)) {
+			Invoke();
+			return;
+		}
+
+		fStore->DeselectAll();
+		fStore->SetSelected(file, line, true);
+	}
+
+	fAnchorFile = file;
+	fAnchorLine = line;
+	Invalidate();
+}
+
+
+void GrepListView::KeyDown(const char *bytes, int32 numBytes)
+{
+	int32 row = fStore->RowOf(fAnchorFile, fAnchorLine);
+	int32 page = (int32) (Bounds().Height() / fRowHeight);
+	bool extend = (modifiers() & B_SHIFT_KEY) != 0;
+
+	switch (bytes[0]) {
+		case B_UP_ARROW:
+			MoveSelection(row - 1, extend);
+			break;
+
+		case B_DOWN_ARROW:
+			MoveSelection(row + 1, extend);
+			break;
+
+		case B_PAGE_UP:
+			MoveSelection(row - page, extend);
+			break;
+
+		case B_PAGE_DOWN:
+			MoveSelection(row + page, extend);
+			break;
+
+		case B_HOME:
+			MoveSelection(0, extend);
+			break;
+
+		case B_END:
+			MoveSelection(fStore->CountRows() - 1, extend);
+			break;
+
+		case B_LEFT_ARROW:
+			if (row >= 0) {
+				if (fAnchorLine >= 0)
+					MoveSelection(fStore->RowOf(fAnchorFile, -1), false);
+				if (fStore->IsExpanded(fAnchorFile))
+					ToggleExpanded(fAnchorFile);
+			}
+			break;
+
+		case B_RIGHT_ARROW:
+			if (row >= 0 && !fStore->IsExpanded(fAnchorFile))
+				ToggleExpanded(fAnchorFile);
+			break;
+
+		case B_ENTER:
+			Invoke();
+			break;
+
+		default:
+			BView::KeyDown(bytes, numBytes);
+			break;
+	}
+}
+
+
+void GrepListView::MessageReceived(BMessage *message)
+{
+	if (message->what == B_SELECT_ALL)
+		SelectAll();
+	else
+		BView::MessageReceived(message);
+}
+
+
+void GrepListView::SetInvocationMessage(BMessage *message)
+{
+	delete fInvocationMessage;
+	fInvocationMessage = message;
+}
+
+
+ResultStore *GrepListView::Store() const
+{
+	return fStore;
+}
+
+
+void GrepListView::Refresh()
+{
+	int32 rowCount = fStore->CountRows();
+
+	// Results are only ever added at the end, so we only redraw 
+	// from the old last row on (its file may have gotten a latch).
+	// If that was out of sight, nothing we can see has changed.
+
+	if (rowCount < fLastRowCount)
+		Invalidate();
+	else if (rowCount > fLastRowCount) {
+		BRect bounds = Bounds();
+		float top = (fLastRowCount > 0 ? fLastRowCount - 1 : 0) * fRowHeight;
+		if (top <= bounds.bottom) {
+			bounds.top = (top > bounds.top) ? top : bounds.top;
+			Invalidate(bounds);
+		}
+	}
+
+	fLastRowCount = rowCount;
+	UpdateScrollBars();
+}
+
+
+void GrepListView::MakeEmpty()
+{
+	fStore->MakeEmpty();
+	fWidestRow = 0;
+	fAnchorFile = -1;
+	fAnchorLine = -1;
+	ScrollTo(0, 0);
+	Refresh();
+}
+
+
+void GrepListView::SetAllExpanded(bool expanded)
+{
+	// Keep the file at the top of the view where it is.
+
+	int32 topFile, topLine;
+	bool hasTop = fStore->GetRow((int32) (Bounds().top / fRowHeight), 
+		&topFile, &topLine);
+
+	fStore->SetAllExpanded(expanded);
+
+	if (fAnchorLine >= 0 && !expanded)
+		fAnchorLine = -1;
+
+	fLastRowCount = fStore->CountRows();
+	UpdateScrollBars();
+
+	if (hasTop) {
+		float top = fStore->RowOf(topFile, -1) * fRowHeight;
+		float bottom = fStore->CountRows() * fRowHeight - Bounds().Height();
+		if (top > bottom)
+			top = bottom;
+		if (top < 0)
+			top = 0;
+		ScrollTo(Bounds().left, top);
+	}
+
+	Invalidate();
+}
+
+
+void GrepListView::SelectAll()
+{
+	SelectRange(0, fStore->CountRows() - 1);
+	Invalidate();
+}
+
+
+void GrepListView::ToggleExpanded(int32 file)
+{
+	fStore->SetExpanded(file, !fStore->IsExpanded(file));
+
+	if (fAnchorFile == file)
+		fAnchorLine = -1;
+
+	fLastRowCount = fStore->CountRows();
+	UpdateScrollBars();
+	Invalidate();
+}
+
+
+void GrepListView::SelectRange(int32 from, int32 to)
+{
+	if (from > to) {
+		int32 temp = from;
+		from = to;
+		to = temp;
+	}
+
+	int32 file, line;
+	if (!fStore->GetRow(from, &file, &line))
+		return;
+
+	for (int32 row = from; row <= to; ++row) {
+		fStore->SetSelected(file, line, true);
+		if (!fStore->NextRow(&file, &line))
+			break;
+	}
+}
+
+
+void GrepListView::MoveSelection(int32 row, bool extend)
+{
+	if (row < 0)
+		row = 0;
+	if (row >= fStore->CountRows())
+		row = fStore->CountRows() - 1;
+
+	int32 file, line;
+	if (!fStore->GetRow(row, &file, &line))
+		return;
+
+	if (!extend)
+		fStore->DeselectAll();
+	fStore->SetSelected(file, line, true);
+
+	fAnchorFile = file;
+	fAnchorLine = line;
+
+	ScrollToRow(row);
+	Invalidate();
+}
+
+
+void GrepListView::ScrollToRow(int32 row)
+{
+	BRect bounds = Bounds();
+	float top = row * fRowHeight;
+
+	if (top < bounds.top)
+		ScrollTo(bounds.left, top);
+	else if (top + fRowHeight > bounds.bottom)
+		ScrollTo(bounds.left, top + fRowHeight - bounds.Height());
+}
+
+
+void GrepListView::UpdateScrollBars()
+{
+	BRect bounds = Bounds();
+
+	BScrollBar *bar = ScrollBar(B_VERTICAL);
+	if (bar != NULL) {
+		float height = fStore->CountRows() * fRowHeight;
+		float range = height - bounds.Height();
+		bar->SetRange(0, range > 0 ? range : 0);
+		bar->SetProportion(height > bounds.Height() 
+			? bounds.Height() / height : 1);
+		bar->SetSteps(fRowHeight, bounds.Height() - fRowHeight);
+	}
+
+	bar = ScrollBar(B_HORIZONTAL);
+	if (bar != NULL) {
+		float range = fWidestRow - bounds.Width();
+		bar->SetRange(0, range > 0 ? range : 0);
+		bar->SetProportion(fWidestRow > bounds.Width() 
+			? bounds.Width() / fWidestRow : 1);
+		bar->SetSteps(10, bounds.Width() / 2);
+	}
+}
+
+
+void GrepListView::Invoke()
 {
-	// void
+	if (fInvocationMessage != NULL && fStore->CountSelected() > 0)
+		Window()->PostMessage(fInvocationMessage);
 }
@@ -20,18 +20,75 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+
 #ifndef __GREP_LIST_VIEW_H__
 #define __GREP_LIST_VIEW_H__
 
-#include <OutlineListView.h>
+#include <View.h>
+
+#include "ResultStore.h"
 
-class GrepListView : public BOutlineListView {
+// Shows the search results. Unlike a BOutlineListView, this doesn't
+// keep an object per row; it draws the visible rows straight from
+// a ResultStore, so it stays fast with millions of lines.
+class GrepListView : public BView {
 	public:
 
 		GrepListView();
+		virtual ~GrepListView();
+		
+		virtual void AttachedToWindow();
+		virtual void Draw(BRect updateRect);
+		virtual void FrameResized(float width, float height);
+		virtual void MouseDown(BPoint where);
+		virtual void KeyDown(const char *bytes, int32 numBytes);
+		virtual void MessageReceived(BMessage *message);
+		
+		// The window gets this message when the user 
+		// double-clicks a row or presses Enter.
+		void SetInvocationMessage(BMessage *message);
+		
+		// The results we show. Call Refresh() after you 
+		// added or removed some.
+		ResultStore *Store() const;
+		void Refresh();
+		
+		void MakeEmpty();
+		void SetAllExpanded(bool expanded);
+		void SelectAll();
 
 	private:
-
+	
+		void DrawRow(BRect frame, int32 file, int32 line);
+		
+		// Draws the text of a line at "pen" in "color" and moves it 
+		// along. The matches are drawn on "highlight".
+		void DrawLineText(BRect frame, BPoint &pen, const char *text, 
+			int32 length, const MatchRange *matches, int32 matchCount,
+			rgb_color background, rgb_color color, rgb_color highlight);
+		void ToggleExpanded(int32 file);
+		void SelectRange(int32 from, int32 to);
+		void MoveSelection(int32 row, bool extend);
+		void ScrollToRow(int32 row);
+		void UpdateScrollBars();
+		void Invoke();
+		
+		ResultStore *fStore;
+		BMessage *fInvocationMessage;
+		
+		float fRowHeight;
+		float fBaseline;
+		
+		// The width of the widest row we have drawn so far.
+		float fWidestRow;
+		
+		// The number of rows the last time we were refreshed.
+		int32 fLastRowCount;
+		
+		// The row the user last clicked or moved to, 
+		// for shift-clicks and the arrow keys.
+		int32 fAnchorFile;
+		int32 fAnchorLine;
 };
 
 #endif // __GREP_LIST_VIEW_H__
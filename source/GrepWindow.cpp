@@ -29,7 +29,6 @@
 #include <String.h>
 #include <UTF8.h>
 
-#include <ctype.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
@@ -38,24 +37,10 @@
 
 #include "TranslZeta.h"
 #include "Grepper.h"
+#include "FuzzyMatcher.h"
 #include "GrepWindow.h"
 
 
-class ResultItem : public BStringItem {
-	public:
-
-		ResultItem(entry_ref &ref) : BStringItem("", 0, false)
-		{
-			this->ref = ref;
-			BEntry entry(&ref);
-			BPath path(&entry);
-			SetText(path.Path()); 
-		}
-	
-		entry_ref ref;
-};
-
-
 GrepWindow::GrepWindow(BMessage *message)
 	: BWindow(BRect(0, 0, 1, 1), NULL, B_DOCUMENT_WINDOW, 0),
 	fSearchText(NULL),
@@ -72,6 +57,8 @@ GrepWindow::GrepWindow(BMessage *message)
 	fSearch(NULL),
 	fTrimSelection(NULL),
 	fCopyText(NULL),
+	fLoadMore(NULL),
+	fResumeSearch(NULL),
 	fSelectInTracker(NULL),
 	fOpenSelection(NULL),
 	fPreferencesMenu(NULL),
@@ -79,10 +66,23 @@ GrepWindow::GrepWindow(BMessage *message)
 	fRecurseDirs(NULL),
 	fSkipDotDirs(NULL),
 	fCaseSensitive(NULL),
+	fWholeWord(NULL),
 	fEscapeText(NULL),
 	fTextOnly(NULL),
 	fInvokePe(NULL),
+	fLiveSearch(NULL),
+	fOrderedResults(NULL),
+	fLazyText(NULL),
+	fMultiLine(NULL),
+	fBooleanQuery(NULL),
 	fShowLinesMenuitem(NULL),
+	fResultsLines(NULL),
+	fResultsFiles(NULL),
+	fResultsCount(NULL),
+	fMaxResultsMenu(NULL),
+	fMaxPerFileMenu(NULL),
+	fContextLinesMenu(NULL),
+	fMaxErrorsMenu(NULL),
 	fHistoryMenu(NULL),
 	fEncodingMenu(NULL),
 	fUTF8(NULL),
@@ -91,7 +91,15 @@ GrepWindow::GrepWindow(BMessage *message)
 	fJIS(NULL),
 	fShowLinesCheckbox(NULL),
 	fButton(NULL),
+	fStatus(NULL),
 	fGrepper(NULL),
+	fSearchTimer(NULL),
+	fLastProgress(0),
+	fLiveSearchRunner(NULL),
+	fIsLiveSearch(false),
+	fLiveSearchPending(false),
+	fPausedFile(-1),
+	fHasResumableResults(false),
 	fModel(NULL),
 	fFilePanel(NULL)
 {
@@ -153,6 +161,9 @@ GrepWindow::~GrepWindow()
 		fGrepper->Cancel();
 	}
 	
+	delete fGrepper;
+	delete fSearchTimer;
+	delete fLiveSearchRunner;
 	delete fModel;
 }
 
@@ -232,6 +243,10 @@ void GrepWindow::MessageReceived(BMessage *message)
 			OnCaseSensitive();
 			break;
 			
+		case MSG_WHOLE_WORD:
+			OnWholeWord();
+			break;
+			
 		case MSG_ESCAPE_TEXT:
 			OnEscapeText();
 			break;
@@ -244,6 +259,30 @@ void GrepWindow::MessageReceived(BMessage *message)
 			OnInvokePe();
 			break;
 			
+		case MSG_ORDERED_RESULTS:
+			OnOrderedResults();
+			break;
+			
+		case MSG_LAZY_TEXT:
+			OnLazyText();
+			break;
+			
+		case MSG_MULTI_LINE:
+			OnMultiLine();
+			break;
+			
+		case MSG_BOOLEAN_QUERY:
+			OnBooleanQuery();
+			break;
+			
+		case MSG_LIVE_SEARCH:
+			OnLiveSearch();
+			break;
+			
+		case MSG_LIVE_SEARCH_TIMER:
+			OnLiveSearchTimer();
+			break;
+			
 		case MSG_SEARCH_TEXT:
 			OnSearchText();
 			break;
@@ -257,19 +296,39 @@ void GrepWindow::MessageReceived(BMessage *message)
 			break;
 			
 		case MSG_SEARCH_FINISHED:
-			OnSearchFinished();
+		case MSG_SEARCH_PAUSED:
+			// The window may still be behind on the results, so we
+			// let the timer wrap up the search once it has caught up.
+			fSearchEnd = *message;
+			OnSearchTimer();
 			break;
 			
-		case MSG_REPORT_FILE_NAME:
-			OnReportFileName(message);
+		case MSG_LOAD_MORE:
+			OnLoadMore();
 			break;
 			
-		case MSG_REPORT_RESULT:
-			OnReportResult(message);
+		case MSG_RESUME_SEARCH:
+			OnResumeSearch();
 			break;
 			
-		case MSG_REPORT_ERROR:
-			OnReportError(message);
+		case MSG_MAX_RESULTS:
+			OnMaxResults(message);
+			break;
+			
+		case MSG_MAX_PER_FILE:
+			OnMaxPerFile(message);
+			break;
+			
+		case MSG_CONTEXT_LINES:
+			OnContextLines(message);
+			break;
+			
+		case MSG_MAX_ERRORS:
+			OnMaxErrors(message);
+			break;
+			
+		case MSG_SEARCH_TIMER:
+			OnSearchTimer();
 			break;
 			
 		case MSG_SELECT_ALL:
@@ -295,6 +354,10 @@ void GrepWindow::MessageReceived(BMessage *message)
 		case MSG_CHECKBOX_SHOW_LINES:
 			OnCheckboxShowLines();
 			break;
+			
+		case MSG_RESULT_MODE:
+			OnResultMode(message);
+			break;
 		
 		case MSG_OPEN_SELECTION:
 			// fall through
@@ -308,18 +371,22 @@ void GrepWindow::MessageReceived(BMessage *message)
 		
 		case 'utf8':
 			fModel->fEncoding = 0;
+			fNarrowPattern = "";
 			break;
 			
 		case B_SJIS_CONVERSION:
 			fModel->fEncoding = B_SJIS_CONVERSION;
+			fNarrowPattern = "";
 			break;
 			
 		case B_EUC_CONVERSION:
 			fModel->fEncoding = B_EUC_CONVERSION;
+			fNarrowPattern = "";
 			break;
 			
 		case B_JIS_CONVERSION:
 			fModel->fEncoding = B_JIS_CONVERSION;
+			fNarrowPattern = "";
 			break;
 		
 		default:
@@ -331,6 +398,12 @@ void GrepWindow::MessageReceived(BMessage *message)
 
 void GrepWindow::Quit()
 {
+	if (fModel->fState == STATE_SEARCH) {
+		fModel->fState = STATE_CANCEL;
+		fGrepper->Cancel();
+		SaveResumeState();
+	}
+
 	SavePrefs();
 
 	if (be_app->Lock()) {
@@ -401,6 +474,12 @@ void GrepWindow::CreateMenus()
 	fCopyText = new BMenuItem(
 		TranslZeta("Copy Text to Clipboard"), new BMessage(MSG_COPY_TEXT), 'B');
 
+	fLoadMore = new BMenuItem(
+		TranslZeta("Load More Results"), new BMessage(MSG_LOAD_MORE), 'M');
+
+	fResumeSearch = new BMenuItem(
+		TranslZeta("Resume Cancelled Search"), new BMessage(MSG_RESUME_SEARCH), 'R');
+
 	fRecurseLinks = new BMenuItem(
 		TranslZeta("Follow symbolic links"), new BMessage(MSG_RECURSE_LINKS));
 
@@ -413,6 +492,9 @@ void GrepWindow::CreateMenus()
 	fCaseSensitive = new BMenuItem(
 		TranslZeta("Case sensitive"), new BMessage(MSG_CASE_SENSITIVE));
 
+	fWholeWord = new BMenuItem(
+		TranslZeta("Whole words only"), new BMessage(MSG_WHOLE_WORD));
+
 	fEscapeText = new BMenuItem(
 		TranslZeta("Escape search text"), new BMessage(MSG_ESCAPE_TEXT));
 
@@ -422,9 +504,111 @@ void GrepWindow::CreateMenus()
 	fInvokePe = new BMenuItem(
 		TranslZeta("Open files in Pe"), new BMessage(MSG_INVOKE_PE));
 
+	fLiveSearch = new BMenuItem(
+		TranslZeta("Search as you type"), new BMessage(MSG_LIVE_SEARCH));
+
+	fOrderedResults = new BMenuItem(
+		TranslZeta("Keep results in order"), 
+		new BMessage(MSG_ORDERED_RESULTS));
+
+	fMultiLine = new BMenuItem(
+		TranslZeta("Match across lines"), new BMessage(MSG_MULTI_LINE));
+
+	fBooleanQuery = new BMenuItem(
+		TranslZeta("Combine words with AND, OR, NOT"), 
+		new BMessage(MSG_BOOLEAN_QUERY));
+
+	fLazyText = new BMenuItem(
+		TranslZeta("Read lines only when shown"), 
+		new BMessage(MSG_LAZY_TEXT));
+
 	fShowLinesMenuitem = new BMenuItem(
 		TranslZeta("Show Lines"), new BMessage(MSG_MENU_SHOW_LINES), 'L');
 	fShowLinesMenuitem->SetMarked(true);
+
+	BMessage *modeMessage = new BMessage(MSG_RESULT_MODE);
+	modeMessage->AddInt32("mode", RESULTS_LINES);
+	fResultsLines = new BMenuItem(
+		TranslZeta("Report matching lines"), modeMessage);
+
+	modeMessage = new BMessage(MSG_RESULT_MODE);
+	modeMessage->AddInt32("mode", RESULTS_FILES);
+	fResultsFiles = new BMenuItem(
+		TranslZeta("Report file names only"), modeMessage);
+
+	modeMessage = new BMessage(MSG_RESULT_MODE);
+	modeMessage->AddInt32("mode", RESULTS_COUNT);
+	fResultsCount = new BMenuItem(
+		TranslZeta("Report match counts only"), modeMessage);
+
+	fMaxResultsMenu = new BMenu(TranslZeta("Stop After"));
+	fMaxResultsMenu->SetRadioMode(true);
+
+	static const int32 kLimits[] = { 1000, 10000, 100000, 0 };
+	for (uint32 t = 0; t < sizeof(kLimits) / sizeof(kLimits[0]); ++t) {
+		BMessage *limitMessage = new BMessage(MSG_MAX_RESULTS);
+		limitMessage->AddInt32("limit", kLimits[t]);
+
+		BString label;
+		if (kLimits[t] > 0)
+			label << kLimits[t] << " " << TranslZeta("results");
+		else
+			label = TranslZeta("No limit");
+
+		fMaxResultsMenu->AddItem(new BMenuItem(label.String(), limitMessage));
+	}
+
+	fMaxPerFileMenu = new BMenu(TranslZeta("Lines Per File"));
+	fMaxPerFileMenu->SetRadioMode(true);
+
+	static const int32 kPerFile[] = { 10, 100, 1000, 0 };
+	for (uint32 t = 0; t < sizeof(kPerFile) / sizeof(kPerFile[0]); ++t) {
+		BMessage *perFileMessage = new BMessage(MSG_MAX_PER_FILE);
+		perFileMessage->AddInt32("limit", kPerFile[t]);
+
+		BString label;
+		if (kPerFile[t] > 0)
+			label << kPerFile[t] << " " << TranslZeta("lines");
+		else
+			label = TranslZeta("No limit");
+
+		fMaxPerFileMenu->AddItem(new BMenuItem(label.String(), 
+			perFileMessage));
+	}
+
+	fContextLinesMenu = new BMenu(TranslZeta("Context Lines"));
+	fContextLinesMenu->SetRadioMode(true);
+
+	static const int32 kContext[] = { 0, 1, 2, 3, 5 };
+	for (uint32 t = 0; t < sizeof(kContext) / sizeof(kContext[0]); ++t) {
+		BMessage *contextMessage = new BMessage(MSG_CONTEXT_LINES);
+		contextMessage->AddInt32("lines", kContext[t]);
+
+		BString label;
+		if (kContext[t] > 0)
+			label << kContext[t];
+		else
+			label = TranslZeta("None");
+
+		fContextLinesMenu->AddItem(new BMenuItem(label.String(), 
+			contextMessage));
+	}
+
+	fMaxErrorsMenu = new BMenu(TranslZeta("Allowed Typos"));
+	fMaxErrorsMenu->SetRadioMode(true);
+
+	for (int32 t = 0; t <= MAX_FUZZY_ERRORS; ++t) {
+		BMessage *errorsMessage = new BMessage(MSG_MAX_ERRORS);
+		errorsMessage->AddInt32("errors", t);
+
+		BString label;
+		if (t > 0)
+			label << t;
+		else
+			label = TranslZeta("None");
+
+		fMaxErrorsMenu->AddItem(new BMenuItem(label.String(), errorsMessage));
+	}
 	
 	fUTF8 = new BMenuItem("UTF8", new BMessage('utf8'));
 	fShiftJIS = new BMenuItem("ShiftJIS", new BMessage(B_SJIS_CONVERSION));
@@ -441,6 +625,8 @@ void GrepWindow::CreateMenus()
 	fFileMenu->AddItem(fQuit);
 	
 	fActionMenu->AddItem(fSearch);
+	fActionMenu->AddItem(fLoadMore);
+	fActionMenu->AddItem(fResumeSearch);
 	fActionMenu->AddSeparatorItem();
 	fActionMenu->AddItem(fSelectAll);
 	fActionMenu->AddItem(fTrimSelection);
@@ -453,11 +639,25 @@ void GrepWindow::CreateMenus()
 	fPreferencesMenu->AddItem(fRecurseDirs);
 	fPreferencesMenu->AddItem(fSkipDotDirs);
 	fPreferencesMenu->AddItem(fCaseSensitive);
+	fPreferencesMenu->AddItem(fWholeWord);
 	fPreferencesMenu->AddItem(fEscapeText);
 	fPreferencesMenu->AddItem(fTextOnly);
+	fPreferencesMenu->AddItem(fMultiLine);
+	fPreferencesMenu->AddItem(fBooleanQuery);
 	fPreferencesMenu->AddItem(fInvokePe);
+	fPreferencesMenu->AddItem(fLiveSearch);
+	fPreferencesMenu->AddItem(fOrderedResults);
+	fPreferencesMenu->AddItem(fLazyText);
 	fPreferencesMenu->AddSeparatorItem();
 	fPreferencesMenu->AddItem(fShowLinesMenuitem);
+	fPreferencesMenu->AddSeparatorItem();
+	fPreferencesMenu->AddItem(fResultsLines);
+	fPreferencesMenu->AddItem(fResultsFiles);
+	fPreferencesMenu->AddItem(fResultsCount);
+	fPreferencesMenu->AddItem(fMaxResultsMenu);
+	fPreferencesMenu->AddItem(fMaxPerFileMenu);
+	fPreferencesMenu->AddItem(fContextLinesMenu);
+	fPreferencesMenu->AddItem(fMaxErrorsMenu);
 	
  	fEncodingMenu->AddItem(fUTF8);
  	fEncodingMenu->AddItem(fShiftJIS);
@@ -479,6 +679,7 @@ void GrepWindow::CreateMenus()
 	SetKeyMenuBar(fMenuBar);
 	
 	fSearch->SetEnabled(false);
+	fLoadMore->SetEnabled(false);
 }
 
 
@@ -514,6 +715,11 @@ void GrepWindow::CreateViews()
 	fShowLinesCheckbox->SetValue(B_CONTROL_ON);
 	fShowLinesCheckbox->ResizeToPreferred();
 	
+	fStatus = new BStringView(
+		BRect(0, 0, 1, 1), "Status", "", B_FOLLOW_LEFT_RIGHT | B_FOLLOW_TOP);
+	
+	fStatus->ResizeToPreferred();
+	
 	fSearchResults = new GrepListView(); 
 
 	fSearchResults->SetInvocationMessage(new BMessage(MSG_INVOKE_ITEM));
@@ -542,10 +748,11 @@ void GrepWindow::LayoutViews()
 		+ 8 + fButton->Frame().Width() + 8;
 
 	float height = 8 + fSearchText->Frame().Height() + 8
-		+ fButton->Frame().Height() + 8 + scroller->Frame().Height();
+		+ fButton->Frame().Height() + 4 + fStatus->Frame().Height() + 8 
+		+ scroller->Frame().Height();
 
 	float backgroundHeight = 8 + fSearchText->Frame().Height()
-		+ 8 + fButton->Frame().Height() + 8;
+		+ 8 + fButton->Frame().Height() + 4 + fStatus->Frame().Height() + 8;
 
 	ResizeTo(width, height);  
 
@@ -554,6 +761,7 @@ void GrepWindow::LayoutViews()
 	background->AddChild(fSearchText);
 	background->AddChild(fShowLinesCheckbox);
 	background->AddChild(fButton);
+	background->AddChild(fStatus);
 
 	fSearchText->MoveTo(8, 8);
 	fSearchText->ResizeBy(width - 16, 0);
@@ -567,6 +775,11 @@ void GrepWindow::LayoutViews()
 		width - fButton->Frame().Width() - 8,
 		8 + fSearchText->Frame().Height() + 8);
 
+	fStatus->MoveTo(
+		8, 8 + fSearchText->Frame().Height() + 8 
+			+ fButton->Frame().Height() + 4);
+	fStatus->ResizeTo(width - 16, fStatus->Frame().Height());
+
 	AddChild(scroller);
 	scroller->MoveTo(0, menubarHeight + 1 + backgroundHeight + 1);
 	scroller->ResizeTo(width + 1, height - backgroundHeight - menubarHeight - 1);
@@ -591,15 +804,54 @@ void GrepWindow::LoadPrefs()
 	fRecurseLinks->SetMarked(fModel->fRecurseLinks);
 	fSkipDotDirs->SetMarked(fModel->fSkipDotDirs);
 	fCaseSensitive->SetMarked(fModel->fCaseSensitive);
+	fWholeWord->SetMarked(fModel->fWholeWord);
 	fEscapeText->SetMarked(fModel->fEscapeText);
 	fTextOnly->SetMarked(fModel->fTextOnly);
 	fInvokePe->SetMarked(fModel->fInvokePe);
+	fLiveSearch->SetMarked(fModel->fLiveSearch);
+	fOrderedResults->SetMarked(fModel->fOrderedResults);
+	fLazyText->SetMarked(fModel->fLazyText);
+	fMultiLine->SetMarked(fModel->fMultiLine);
+	fBooleanQuery->SetMarked(fModel->fBooleanQuery);
+	fResumeSearch->SetEnabled(!fModel->fResumeState.IsEmpty());
 
 	fShowLinesCheckbox->SetValue(
 		fModel->fShowContents ? B_CONTROL_ON : B_CONTROL_OFF);
 	fShowLinesMenuitem->SetMarked(
 		fModel->fShowContents ? true : false);
 
+	fResultsLines->SetMarked(fModel->fResultMode == RESULTS_LINES);
+	fResultsFiles->SetMarked(fModel->fResultMode == RESULTS_FILES);
+	fResultsCount->SetMarked(fModel->fResultMode == RESULTS_COUNT);
+
+	for (int32 t = 0; t < fMaxResultsMenu->CountItems(); ++t) {
+		BMenuItem *item = fMaxResultsMenu->ItemAt(t);
+		int32 limit;
+		if (item->Message()->FindInt32("limit", &limit) == B_OK)
+			item->SetMarked(limit == fModel->fMaxResults);
+	}
+
+	for (int32 t = 0; t < fMaxPerFileMenu->CountItems(); ++t) {
+		BMenuItem *item = fMaxPerFileMenu->ItemAt(t);
+		int32 limit;
+		if (item->Message()->FindInt32("limit", &limit) == B_OK)
+			item->SetMarked(limit == fModel->fMaxPerFile);
+	}
+
+	for (int32 t = 0; t < fContextLinesMenu->CountItems(); ++t) {
+		BMenuItem *item = fContextLinesMenu->ItemAt(t);
+		int32 lines;
+		if (item->Message()->FindInt32("lines", &lines) == B_OK)
+			item->SetMarked(lines == fModel->fContextLines);
+	}
+
+	for (int32 t = 0; t < fMaxErrorsMenu->CountItems(); ++t) {
+		BMenuItem *item = fMaxErrorsMenu->ItemAt(t);
+		int32 errors;
+		if (item->Message()->FindInt32("errors", &errors) == B_OK)
+			item->SetMarked(errors == fModel->fMaxErrors);
+	}
+
 	switch (fModel->fEncoding)
 	{
 		case 0:
@@ -635,32 +887,22 @@ void GrepWindow::SavePrefs()
 void GrepWindow::OnStartCancel()
 {
 	if (fModel->fState == STATE_IDLE) {
+		delete fLiveSearchRunner;
+		fLiveSearchRunner = NULL;
+		
+		DiscardPausedSearch();
+		
 		fModel->fState = STATE_SEARCH;
 
 		fSearchResults->MakeEmpty();
+		fHasResumableResults = false;
 		
 		if (fSearchText->TextView()->TextLength() == 0)
 			return;
 
 		fModel->AddToHistory(fSearchText->Text());
 
-		// From now on, we don't want to be notified when the
-		// search pattern changes, because the control will be
-		// displaying the names of the files we are grepping.
-
-		fSearchText->SetModificationMessage(NULL);
-
-		fFileMenu->SetEnabled(false);
-		fActionMenu->SetEnabled(false);
-		fPreferencesMenu->SetEnabled(false);
-		fHistoryMenu->SetEnabled(false);
-		fEncodingMenu->SetEnabled(false);
-		
-		fSearchText->SetEnabled(false);
-
-		fButton->MakeFocus(true);
-		fButton->SetLabel(TranslZeta("Cancel"));
-		fSearch->SetEnabled(false);
+		DisableControls(false);
 
 		// We need to remember the search pattern, because during 
 		// the grepping, the text control's text will be replaced 
@@ -674,18 +916,190 @@ void GrepWindow::OnStartCancel()
 		fGrepper->Start();
 	} else if (fModel->fState == STATE_SEARCH) {
 		fModel->fState = STATE_CANCEL;
+		fLiveSearchPending = false;
 		fGrepper->Cancel();
+		SaveResumeState();
+	}
+}
+
+
+void GrepWindow::SaveResumeState()
+{
+	// Remember how far the search got, so that the user can 
+	// continue it later on, even after quitting Tracker Grep.
+
+	BMessage cursor;
+	if (fGrepper->GetCursor(&cursor) != B_OK)
+		return;
+
+	BMessage options;
+	fModel->SaveOptions(&options);
+
+	BMessage state;
+	state.AddString("pattern", fOldPattern.String());
+	state.AddRef("dir_ref", &fModel->fDirectory);
+	state.AddMessage("selection", &fModel->fSelectedFiles);
+	state.AddMessage("options", &options);
+	state.AddMessage("cursor", &cursor);
+
+	fModel->fResumeState = state;
+	fHasResumableResults = true;
+	SavePrefs();
+}
+
+
+void GrepWindow::OnResumeSearch()
+{
+	if (fModel->fState != STATE_IDLE || fModel->fResumeState.IsEmpty())
+		return;
+
+	BMessage state = fModel->fResumeState;
+	fModel->fResumeState.MakeEmpty();
+	SavePrefs();
+
+	const char *pattern;
+	BMessage cursor;
+	if (state.FindString("pattern", &pattern) != B_OK
+		|| state.FindMessage("cursor", &cursor) != B_OK)
+		return;
+
+	DiscardPausedSearch();
+
+	entry_ref directory;
+	state.FindRef("dir_ref", &directory);
+	fModel->fDirectory = directory;
+
+	fModel->fSelectedFiles.MakeEmpty();
+	state.FindMessage("selection", &fModel->fSelectedFiles);
+
+	// The cursor only makes sense with the options the search was
+	// started with, so put those back (and show them in the menus)
+	// before we continue.
+
+	BMessage options;
+	if (state.FindMessage("options", &options) == B_OK) {
+		fModel->RestoreOptions(&options);
+		SavePrefs();
+		LoadPrefs();
+	}
+
+	SetWindowTitle();
+
+	// If the list still shows what we found before the user 
+	// cancelled, we simply add the rest of the results to it.
+
+	if (!fHasResumableResults)
+		fSearchResults->MakeEmpty();
+
+	fHasResumableResults = false;
+	fNarrowPattern = "";
+	fOldPattern = pattern;
+
+	fModel->fState = STATE_SEARCH;
+
+	DisableControls(false);
+	fSearchText->SetText(pattern);
+
+	fGrepper = new Grepper(pattern, fModel);
+	fGrepper->SetCursor(&cursor);
+	fGrepper->Start();
+}
+
+
+void GrepWindow::DisableControls(bool live)
+{
+	fIsLiveSearch = live;
+
+	if (!live) {
+		// The search pattern can't be changed while we are
+		// searching for it. During a live search we leave the
+		// search text control alone, because the user may
+		// still be typing in it.
+
+		fSearchText->SetModificationMessage(NULL);
+		fSearchText->SetEnabled(false);
+		fButton->MakeFocus(true);
 	}
+
+	fFileMenu->SetEnabled(false);
+	fActionMenu->SetEnabled(false);
+	fPreferencesMenu->SetEnabled(false);
+	fHistoryMenu->SetEnabled(false);
+	fEncodingMenu->SetEnabled(false);
+	
+	fButton->SetLabel(TranslZeta("Cancel"));
+	fSearch->SetEnabled(false);
+
+	fStatus->SetText("");
+	fLastProgress = 0;
+
+	delete fSearchTimer;
+	BMessage message(MSG_SEARCH_TIMER);
+	fSearchTimer = new BMessageRunner(
+		BMessenger(this), &message, SEARCH_TIMER_INTERVAL);
 }
 
 
 void GrepWindow::OnSearchFinished()
 {
-	fModel->fState = STATE_IDLE;
+	// Only the results of a search that ran all the way 
+	// through can be used to narrow down the next one.
+
+	if (fModel->fState == STATE_SEARCH)
+		fNarrowPattern = fOldPattern;
+	else
+		fNarrowPattern = "";
+
+	if (fGrepper != NULL)
+		ShowProgress(false);
 
 	delete fGrepper;
 	fGrepper = NULL;
 
+	EnableControls();
+}
+
+
+void GrepWindow::OnSearchPaused(BMessage *message)
+{
+	if (fModel->fState != STATE_SEARCH) {
+		// The user cancelled the search before 
+		// the grepper thread saw it coming.
+		OnSearchFinished();
+		return;
+	}
+
+	// We hang on to the grepper, so it can pick up
+	// where it left off when the user wants more.
+
+	fNarrowPattern = "";
+
+	ShowProgress(false);
+
+	int32 count = 0;
+	message->FindInt32("count", &count);
+
+	BString text;
+	text << TranslZeta("Stopped after") << " " << count << " " 
+		<< TranslZeta("results.") << " " 
+		<< TranslZeta("Choose \"Load More Results\" to continue.");
+
+	fPausedFile = fSearchResults->Store()->AddMessage(text.String());
+	fSearchResults->Refresh();
+
+	EnableControls();
+
+	fLoadMore->SetEnabled(true);
+}
+
+
+void GrepWindow::EnableControls()
+{
+	fModel->fState = STATE_IDLE;
+
+	delete fSearchTimer;
+	fSearchTimer = NULL;
+
 	fFileMenu->SetEnabled(true);
 	fActionMenu->SetEnabled(true);
 	fPreferencesMenu->SetEnabled(true);
@@ -695,6 +1109,21 @@ void GrepWindow::OnSearchFinished()
 	fButton->SetLabel(TranslZeta("Search"));
 	fButton->SetEnabled(true);
 	fSearch->SetEnabled(true);
+	fLoadMore->SetEnabled(false);
+	fResumeSearch->SetEnabled(!fModel->fResumeState.IsEmpty());
+	
+	if (fIsLiveSearch) {
+		// The search text control was never touched,
+		// so there is nothing to restore.
+
+		fIsLiveSearch = false;
+
+		if (fLiveSearchPending) {
+			fLiveSearchPending = false;
+			StartLiveSearch();
+		}
+		return;
+	}
 	
 	fSearchText->SetEnabled(true);
 	fSearchText->MakeFocus(true);
@@ -704,48 +1133,204 @@ void GrepWindow::OnSearchFinished()
 }
 
 
-void GrepWindow::OnReportFileName(BMessage *message)
+void GrepWindow::OnLoadMore()
+{
+	if (fModel->fState != STATE_IDLE || fGrepper == NULL)
+		return;
+
+	// Nothing was added after the message that we paused.
+	if (fPausedFile >= 0) {
+		fSearchResults->Store()->RemoveLastFile();
+		fSearchResults->Refresh();
+		fPausedFile = -1;
+	}
+
+	fModel->fState = STATE_SEARCH;
+
+	DisableControls(false);
+
+	fGrepper->Resume();
+}
+
+
+void GrepWindow::DiscardPausedSearch()
+{
+	// A paused search keeps its grepper until the user
+	// starts a new search or picks some other files.
+
+	if (fModel->fState == STATE_IDLE && fGrepper != NULL) {
+		delete fGrepper;
+		fGrepper = NULL;
+		fPausedFile = -1;
+		fLoadMore->SetEnabled(false);
+	}
+}
+
+
+void GrepWindow::OnSearchTimer()
 {
-	fSearchText->SetText(message->FindString("filename"));
+	// The timer may still fire once after the search ended.
+	if (fModel->fState != STATE_IDLE && fGrepper != NULL) {
+		bool caughtUp = ReadResults(RESULT_FRAME_BUDGET);
+
+		if (caughtUp && fSearchEnd.what != 0) {
+			BMessage end(fSearchEnd);
+			fSearchEnd.MakeEmpty();
+			fSearchEnd.what = 0;
+
+			if (end.what == MSG_SEARCH_PAUSED)
+				OnSearchPaused(&end);
+			else
+				OnSearchFinished();
+			return;
+		}
+
+		bigtime_t now = system_time();
+		if (now - fLastProgress >= PROGRESS_INTERVAL) {
+			fLastProgress = now;
+			ShowProgress(true);
+		}
+	}
+}
+
+
+void GrepWindow::ShowProgress(bool showFile)
+{
+	BMessage progress;
+	fGrepper->GetProgress(&progress);
+
+	int32 files = 0;
+	int64 bytes = 0;
+	int32 results = 0;
+	const char *file = NULL;
+	progress.FindInt32("files", &files);
+	progress.FindInt64("bytes", &bytes);
+	progress.FindInt32("results", &results);
+	progress.FindString("file", &file);
+
+	BString text;
+	text << files << " " << TranslZeta("files") << ", ";
+	
+	if (bytes < 1024 * 1024)
+		text << (int32) (bytes / 1024) << " KB";
+	else
+		text << (int32) (bytes / (1024 * 1024)) << " MB";
+
+	text << ", " << results << " " << TranslZeta("results");
+
+	if (showFile && file != NULL && *file != '\0')
+		text << ": " << file;
+
+	BFont font;
+	fStatus->GetFont(&font);
+	font.TruncateString(&text, B_TRUNCATE_MIDDLE, fStatus->Bounds().Width());
+
+	fStatus->SetText(text.String());
 }
 
 		
-void GrepWindow::OnReportResult(BMessage *message)
+bool GrepWindow::ReadResults(bigtime_t budget)
 {
+	// We pick up what the workers found since the last time, so
+	// we only have to redraw the list once for all. If that takes
+	// too long, we leave the rest for the next time, and let the
+	// window handle the user's clicks and keys in between.
+	// Returns whether there is nothing left to read for now.
+
+	bigtime_t deadline = system_time() + budget;
+	bool caughtUp = true;
+
+	int32 count = 0;
+	BMessage *message;
+	while (fGrepper->ReadResult(&message)) {
+		if (message->what == MSG_REPORT_ERROR)
+			OnReportError(message);
+		else
+			AddResult(message);
+		delete message;
+
+		// system_time() is cheap, but not free.
+		if ((++count & 15) == 0 && system_time() >= deadline) {
+			caughtUp = false;
+			break;
+		}
+	}
+
+	if (count > 0)
+		fSearchResults->Refresh();
+
+	return caughtUp;
+}
+
+
+void GrepWindow::AddResult(BMessage *message)
+{
+	ResultStore *store = fSearchResults->Store();
+
+	// The workers have already cleaned up the text of the lines, 
+	// so the store takes it over without even looking at it.
+
+	char *lines = NULL;
+	if (message->FindPointer("lines", (void**) &lines) == B_OK) {
+		int32 size = 0;
+		message->FindInt32("lines_size", &size);
+		store->AdoptText(lines, size);
+	}
+
 	entry_ref ref;
 	if (message->FindRef("ref", &ref) != B_OK)
 		return;
 
-	BStringItem *item = new ResultItem(ref);
-	fSearchResults->AddItem(item);
-	item->SetExpanded(fModel->fShowContents);
-
-	type_code type;
-	int32 count;
-	message->GetInfo("text", &type, &count);
+	const char *fileName;
+	BPath path;
+	if (message->FindString("filename", &fileName) != B_OK) {
+		BEntry entry(&ref);
+		path.SetTo(&entry);
+		fileName = (path.Path() != NULL) ? path.Path() : ref.name;
+	}
 
-	const char *buf;
-	while (message->FindString("text", --count, &buf) == B_OK) {
-		uchar *temp = (uchar*) strdup(buf);
-		uchar *ptr  = temp;
+	int32 matchCount;
+	if (message->FindInt32("count", &matchCount) != B_OK)
+		matchCount = -1;
+
+	int32 file = store->AddFile(&ref, fileName, matchCount, 
+		fModel->fShowContents);
+
+	// Lines without text are read from the file when they are shown.
+
+	int32 number;
+	for (int32 t = 0; message->FindInt32("line", t, &number) == B_OK; ++t) {
+		int64 offset;
+		int32 length;
+		int32 text;
+		int32 matchOffset;
+		int32 matchCount;
+		if (message->FindInt64("offset", t, &offset) != B_OK
+			|| message->FindInt32("length", t, &length) != B_OK
+			|| message->FindInt32("text", t, &text) != B_OK
+			|| message->FindInt32("matches", t, &matchOffset) != B_OK
+			|| message->FindInt32("match_count", t, &matchCount) != B_OK)
+			break;
 
-		while (true) {
-			// replace all non-printable characters by spaces
-			uchar c = *ptr;
+		bool context;
+		if (message->FindBool("context", t, &context) != B_OK)
+			context = false;
 
-			if (c == '\0')
-				break;
+		int32 distance;
+		if (message->FindInt32("distance", t, &distance) != B_OK)
+			distance = 0;
 
-			if (!(c & 0x80) && iscntrl(c))
-				*ptr = ' ';
+		const MatchRange *matches = NULL;
+		if (matchOffset >= 0 && lines != NULL)
+			matches = (const MatchRange*) (lines + matchOffset);
 
-			++ptr;
+		if (text >= 0 && lines != NULL) {
+			store->AddLine(file, number, offset, lines + text, length, 
+				matches, matchCount, context, distance);
+		} else if (offset >= 0) {
+			store->AddLine(file, number, offset, NULL, length, 
+				matches, matchCount, context, distance);
 		}
-
-		fSearchResults->AddUnder(
-			new BStringItem((const char*) temp), item);
-
-		free(temp);
 	}
 }
 
@@ -754,7 +1339,7 @@ void GrepWindow::OnReportError(BMessage *message)
 {
 	const char *buf;
 	if (message->FindString("error", &buf) == B_OK)
-		fSearchResults->AddItem(new BStringItem(buf));
+		fSearchResults->Store()->AddMessage(buf);
 }
 
 
@@ -762,6 +1347,7 @@ void GrepWindow::OnRecurseLinks()
 {
 	fModel->fRecurseLinks = !fModel->fRecurseLinks;
 	fRecurseLinks->SetMarked(fModel->fRecurseLinks);
+	fNarrowPattern = "";
 	SavePrefs();
 }
 
@@ -770,6 +1356,7 @@ void GrepWindow::OnRecurseDirs()
 {
 	fModel->fRecurseDirs = !fModel->fRecurseDirs;
 	fRecurseDirs->SetMarked(fModel->fRecurseDirs);
+	fNarrowPattern = "";
 	SavePrefs();
 }
 
@@ -778,6 +1365,7 @@ void GrepWindow::OnSkipDotDirs()
 {
 	fModel->fSkipDotDirs = !fModel->fSkipDotDirs;
 	fSkipDotDirs->SetMarked(fModel->fSkipDotDirs);
+	fNarrowPattern = "";
 	SavePrefs();
 }
 
@@ -786,6 +1374,7 @@ void GrepWindow::OnEscapeText()
 {
 	fModel->fEscapeText = !fModel->fEscapeText;
 	fEscapeText->SetMarked(fModel->fEscapeText);
+	fNarrowPattern = "";
 	SavePrefs();
 }
 
@@ -794,6 +1383,16 @@ void GrepWindow::OnCaseSensitive()
 {
 	fModel->fCaseSensitive = !fModel->fCaseSensitive;
 	fCaseSensitive->SetMarked(fModel->fCaseSensitive);
+	fNarrowPattern = "";
+	SavePrefs();
+}
+
+
+void GrepWindow::OnWholeWord()
+{
+	fModel->fWholeWord = !fModel->fWholeWord;
+	fWholeWord->SetMarked(fModel->fWholeWord);
+	fNarrowPattern = "";
 	SavePrefs();
 }
 
@@ -802,6 +1401,7 @@ void GrepWindow::OnTextOnly()
 {
 	fModel->fTextOnly = !fModel->fTextOnly;
 	fTextOnly->SetMarked(fModel->fTextOnly);
+	fNarrowPattern = "";
 	SavePrefs();
 }
 
@@ -814,63 +1414,119 @@ void GrepWindow::OnInvokePe()
 }
 
 
+void GrepWindow::OnLiveSearch()
+{
+	fModel->fLiveSearch = !fModel->fLiveSearch;
+	fLiveSearch->SetMarked(fModel->fLiveSearch);
+	SavePrefs();
+}
+
+
+void GrepWindow::OnOrderedResults()
+{
+	fModel->fOrderedResults = !fModel->fOrderedResults;
+	fOrderedResults->SetMarked(fModel->fOrderedResults);
+	SavePrefs();
+}
+
+
+void GrepWindow::OnMultiLine()
+{
+	fModel->fMultiLine = !fModel->fMultiLine;
+	fMultiLine->SetMarked(fModel->fMultiLine);
+	fNarrowPattern = "";
+	SavePrefs();
+}
+
+
+void GrepWindow::OnBooleanQuery()
+{
+	fModel->fBooleanQuery = !fModel->fBooleanQuery;
+	fBooleanQuery->SetMarked(fModel->fBooleanQuery);
+	fNarrowPattern = "";
+	SavePrefs();
+}
+
+
+void GrepWindow::OnLazyText()
+{
+	fModel->fLazyText = !fModel->fLazyText;
+	fLazyText->SetMarked(fModel->fLazyText);
+	SavePrefs();
+}
+
+
 void GrepWindow::OnCheckboxShowLines()
 {
 	// toggle checkbox and menuitem
 	fModel->fShowContents = !fModel->fShowContents;
 	fShowLinesMenuitem->SetMarked(!fShowLinesMenuitem->IsMarked());
 	
-	// Selection in BOutlineListView in multiple selection mode
-	// gets weird when collapsing. I've tried all sorts of things.
-	// It seems impossible to make it behave just right.
-	
-	// Going from collapsed to expande mode, the superitems
-	// keep their selection, the subitems don't (yet) have 
-	// a selection. This works as expected, AFAIK.
-	
-	// Going from expanded to collapsed mode, I would like
-	// for a selected subitem (line) to select its superitem,
-	// (its file) and the subitem be unselected. 
-	
-	// I've successfully tried code patches that apply the
-	// selection pattern that I want, but with weird effects
-	// on subsequent manual selection. 
-	// Lines stay selected while the user tries to select
-	// some other line. It just gets weird. 
-	
-	// It's as though listItem->Select() and Deselect() 
-	// put the items in some semi-selected state.
-	// Or maybe I've got it all wrong.
-	
-	// So, here's the plain basic collapse/expand. 
-	// I think it's the least bad of what's possible on BeOS R5,
-	// but perhaps someone comes along with a patch of magic.
+	// Collapsing a file moves the selection of its lines
+	// onto the file itself.
 
-	int32 numItems = fSearchResults->FullListCountItems();
-	BListItem *listItem = NULL;
+	fSearchResults->SetAllExpanded(fModel->fShowContents);
+
+	SavePrefs();
+}
 
-	for (int32 x = 0; x < numItems; ++x) {
-	
-		listItem = fSearchResults->FullListItemAt(x);
-		
-		if (listItem->OutlineLevel() == 0)
-		{
-			if (fModel->fShowContents) {
-				if (!fSearchResults->IsExpanded(x))
-					fSearchResults->Expand(listItem);
-			} else {
-				if (fSearchResults->IsExpanded(x))
-					fSearchResults->Collapse(listItem);
-			}
-		}
-	}
-	
-	fSearchResults->Invalidate();
 
+void GrepWindow::OnResultMode(BMessage *message)
+{
+	int32 mode;
+	if (message->FindInt32("mode", &mode) != B_OK)
+		return;
+
+	fModel->fResultMode = (result_mode_t) mode;
+	fResultsLines->SetMarked(fModel->fResultMode == RESULTS_LINES);
+	fResultsFiles->SetMarked(fModel->fResultMode == RESULTS_FILES);
+	fResultsCount->SetMarked(fModel->fResultMode == RESULTS_COUNT);
+	fNarrowPattern = "";
 	SavePrefs();
 }
 
 
+void GrepWindow::OnMaxResults(BMessage *message)
+{
+	int32 limit;
+	if (message->FindInt32("limit", &limit) == B_OK) {
+		fModel->fMaxResults = limit;
+		SavePrefs();
+	}
+}
+
+
+void GrepWindow::OnMaxPerFile(BMessage *message)
+{
+	int32 limit;
+	if (message->FindInt32("limit", &limit) == B_OK) {
+		fModel->fMaxPerFile = limit;
+		SavePrefs();
+	}
+}
+
+
+void GrepWindow::OnContextLines(BMessage *message)
+{
+	int32 lines;
+	if (message->FindInt32("lines", &lines) == B_OK) {
+		fModel->fContextLines = lines;
+		SavePrefs();
+	}
+}
+
+
+void GrepWindow::OnMaxErrors(BMessage *message)
+{
+	int32 errors;
+	if (message->FindInt32("errors", &errors) == B_OK) {
+		fModel->fMaxErrors = errors;
+		fNarrowPattern = "";
+		SavePrefs();
+	}
+}
+
+
 void GrepWindow::OnMenuShowLines()
 {
 	// toggle companion checkbox
@@ -905,49 +1561,30 @@ bool GrepWindow::OpenInPe(const entry_ref &ref, int32 lineNum)
 
 void GrepWindow::OnInvokeItem()
 {
-	BListItem *item = NULL;
-	int32 selectionIndex = -1;
+	ResultStore *store = fSearchResults->Store();
+	int32 file, line;
 
-	for (int32 itemIndex = 0; ; itemIndex++) {
-		selectionIndex = fSearchResults->CurrentSelection(itemIndex); 
-	
-		if (selectionIndex >= 0)
-			item = fSearchResults->ItemAt(selectionIndex);
-		else
-			break;
-		
-		if (item != NULL) {
-			int32 level = item->OutlineLevel();
-			int32 lineNum = -1;
-	
-			// Get the line number.
-			// only this level has line numbers
-			if (level == 1) {
-				BStringItem *str = dynamic_cast<BStringItem*>(item);
-				if (str != NULL) {
-					lineNum = atol(str->Text());
-						// fortunately, atol knows when to stop the conversion
-				}
-			}
-	
-			// Get the top-most item and launch its entry_ref.
-			while (level != 0) {
-				item = fSearchResults->Superitem(item);
-				if (!item)
-					break;
-				level = item->OutlineLevel();
-			}
-	
-			ResultItem *entry = dynamic_cast<ResultItem*>(item);
-			if (entry != NULL) {
-				bool done = false;
-	
-				if (fModel->fInvokePe)
-					done = OpenInPe(entry->ref, lineNum);
-	
-				if (!done)
-					be_roster->Launch(&entry->ref);
-			}
+	for (bool more = store->GetRow(0, &file, &line); more; 
+			more = store->NextRow(&file, &line)) {
+		if (!store->IsSelected(file, line))
+			continue;
+
+		// Only lines have line numbers, and then only
+		// if grep gave us one.
+
+		int32 lineNum = -1;
+		if (line >= 0 && store->LineNumber(file, line) > 0)
+			lineNum = store->LineNumber(file, line);
+
+		entry_ref ref;
+		if (store->GetRef(file, &ref)) {
+			bool done = false;
+
+			if (fModel->fInvokePe)
+				done = OpenInPe(ref, lineNum);
+
+			if (!done)
+				be_roster->Launch(&ref);
 		}
 	}
 }
@@ -957,6 +1594,96 @@ void GrepWindow::OnSearchText()
 {
 	fButton->SetEnabled(fSearchText->TextView()->TextLength() != 0);
 	fSearch->SetEnabled(fSearchText->TextView()->TextLength() != 0);
+
+	if (fModel->fLiveSearch) {
+		// Restart the countdown on every keystroke, so we
+		// don't start searching for each letter separately.
+
+		delete fLiveSearchRunner;
+		BMessage message(MSG_LIVE_SEARCH_TIMER);
+		fLiveSearchRunner = new BMessageRunner(
+			BMessenger(this), &message, LIVE_SEARCH_DELAY, 1);
+	}
+}
+
+
+void GrepWindow::OnLiveSearchTimer()
+{
+	delete fLiveSearchRunner;
+	fLiveSearchRunner = NULL;
+	
+	bool hasText = (fSearchText->TextView()->TextLength() != 0);
+
+	if (fModel->fState == STATE_IDLE) {
+		if (hasText)
+			StartLiveSearch();
+	} else if (fIsLiveSearch) {
+		// The pattern changed while we were still searching
+		// for the old one. OnSearchFinished() starts the new
+		// search once the old grepper thread has quit.
+
+		fLiveSearchPending = hasText;
+
+		if (fModel->fState == STATE_SEARCH) {
+			fModel->fState = STATE_CANCEL;
+			fGrepper->Cancel();
+		}
+	}
+}
+
+
+void GrepWindow::StartLiveSearch()
+{
+	BString pattern = fSearchText->Text();
+
+	// If the new pattern contains the previous one, then every line 
+	// it matches also matched the previous search. In that case we 
+	// only need to look at the files that are already in the list.
+	// This only holds for plain text patterns, and not for JIS with
+	// its shift sequences, or for queries, where "a OR b" contains "a".
+	// Nor for whole words: "xfoo" contains "foo", but not as a word,
+	// or for typos, which may make the longer text closer to a line.
+	// Nor for multi-line text: "a\" is in "a\n", but a line break 
+	// isn't a backslash.
+
+	bool narrowing = false;
+	
+	if (fModel->fEscapeText && fNarrowPattern.Length() > 0
+		&& fModel->fEncoding != B_JIS_CONVERSION && !fModel->fBooleanQuery
+		&& !fModel->fWholeWord && fModel->fMaxErrors == 0
+		&& !fModel->fMultiLine) {
+		if (fModel->fCaseSensitive)
+			narrowing = (pattern.FindFirst(fNarrowPattern.String()) >= 0);
+		else
+			narrowing = (pattern.IFindFirst(fNarrowPattern.String()) >= 0);
+	}
+
+	BMessage candidates;
+
+	if (narrowing) {
+		ResultStore *store = fSearchResults->Store();
+
+		for (int32 t = 0; t < store->CountFiles(); ++t) {
+			entry_ref ref;
+			if (store->GetRef(t, &ref))
+				candidates.AddRef("refs", &ref);
+		}
+	}
+
+	DiscardPausedSearch();
+
+	fModel->fState = STATE_SEARCH;
+
+	fSearchResults->MakeEmpty();
+	fHasResumableResults = false;
+
+	DisableControls(true);
+
+	fOldPattern = pattern;
+
+	fGrepper = new Grepper(fOldPattern.String(), fModel,
+		narrowing ? &candidates : NULL);
+	fGrepper->Start();
 }
 
 
@@ -970,7 +1697,9 @@ void GrepWindow::OnHistoryItem(BMessage *message)
 
 void GrepWindow::OnTrimSelection()
 {
-	if (fSearchResults->CurrentSelection() < 0) {
+	ResultStore *store = fSearchResults->Store();
+
+	if (store->CountSelected() == 0) {
 		BString text;
 		text << TranslZeta("Please select the files you wish to keep searching.") << "\n";
 		text << TranslZeta("The unselected files will be removed from the list.") << "\n";
@@ -980,27 +1709,21 @@ void GrepWindow::OnTrimSelection()
 		return;
 	}
 	
-	BStringItem *item = NULL;
-	BStringItem *fileItem = NULL;
+	int32 file, line;
+	int32 lastFile = -1;
 	
 	BMessage message;
-	BString path;
 
-	for (int32 index = 0; ; index++) {
-		item = dynamic_cast<BStringItem*>(fSearchResults->ItemAt(index));
-		if (item == NULL)
-			break;
-		
-		if (item->OutlineLevel() == 0)
-			fileItem = item;
-		
-		if (item->IsSelected())	{
-			if (path != fileItem->Text()) {
-				path = fileItem->Text();
-				entry_ref ref;
-				
-				if (get_ref_for_path(path.String(), &ref) == B_OK)
-					message.AddRef("refs", &ref);
+	for (bool more = store->GetRow(0, &file, &line); more; 
+			more = store->NextRow(&file, &line)) {
+		// The label of a file isn't always a plain path
+		// name, so we go by its entry_ref instead.
+
+		if (store->IsSelected(file, line) && file != lastFile) {
+			entry_ref ref;
+			if (store->GetRef(file, &ref)) {
+				lastFile = file;
+				message.AddRef("refs", &ref);
 			}
 		}
 	}
@@ -1008,6 +1731,8 @@ void GrepWindow::OnTrimSelection()
 	entry_ref directory;
 	fModel->fDirectory = directory;
 		// invalidated on purpose
+
+	fNarrowPattern = "";
 		
 	fModel->fSelectedFiles.MakeEmpty();
 	fModel->fSelectedFiles = message;
@@ -1020,24 +1745,40 @@ void GrepWindow::OnTrimSelection()
 
 void GrepWindow::OnCopyText()
 {
+	ResultStore *store = fSearchResults->Store();
+
 	bool onlyCopySelection = true;
 	
-	if (fSearchResults->CurrentSelection() < 0)
+	if (store->CountSelected() == 0)
 		onlyCopySelection = false;
 	
-	BStringItem *item = NULL;
+	int32 file, line;
 	BString buffer;
 
-	for (int32 index = 0; ; index++) {
-		item = dynamic_cast<BStringItem*>(fSearchResults->ItemAt(index));
-		if (item == NULL)
-			break;
-		
-		if (onlyCopySelection) {
-			if (item->IsSelected())
-				buffer << item->Text() << "\n";
-		} else
-			buffer << item->Text() << "\n";
+	for (bool more = store->GetRow(0, &file, &line); more; 
+			more = store->NextRow(&file, &line)) {
+		if (onlyCopySelection && !store->IsSelected(file, line))
+			continue;
+
+		if (line < 0)
+			buffer << store->FileLabel(file) << "\n";
+		else {
+			// Like grep, we put a '-' after the line 
+			// numbers of context lines.
+
+			int32 number = store->LineNumber(file, line);
+			if (number > 0) {
+				buffer << number;
+				if (store->Distance(file, line) > 0)
+					buffer << "~" << store->Distance(file, line);
+				buffer << (store->IsContext(file, line) ? "-" : ":");
+			}
+
+			int32 length;
+			const char *text = store->LineText(file, line, &length);
+			buffer.Append(text, length);
+			buffer << "\n";
+		}
 	}
 	
 	status_t status = B_OK;
@@ -1066,7 +1807,9 @@ void GrepWindow::OnCopyText()
 
 void GrepWindow::OnSelectInTracker()
 {
-	if (fSearchResults->CurrentSelection() < 0) {
+	ResultStore *store = fSearchResults->Store();
+
+	if (store->CountSelected() == 0) {
 		BAlert *alert = new BAlert(NULL,
 			TranslZeta("Please select the files you wish to have selected for you in Tracker."),
 			TranslZeta("Okay"), NULL, NULL, B_WIDTH_AS_USUAL, B_WARNING_ALERT);
@@ -1074,33 +1817,27 @@ void GrepWindow::OnSelectInTracker()
 		return;
 	}
 
-	BStringItem *item = NULL;
-	BStringItem *fileItem = NULL;
+	int32 file, line;
+	int32 lastFile = -1;
 	
 	BMessage message;
-	BString filePath;
 	BPath folderPath;
 	BList folderList;
 	BString lastFolderAddedToList;
 
-	for (int32 index = 0; ; index++) {
-		item = dynamic_cast<BStringItem*>(fSearchResults->ItemAt(index));
-		if (item == NULL)
-			break;
-		
-		if (item->OutlineLevel() == 0)
-			fileItem = item;
+	for (bool more = store->GetRow(0, &file, &line); more; 
+			more = store->NextRow(&file, &line)) {
+		entry_ref ref;
 		
-		if (item->IsSelected()) {
-			if (filePath != fileItem->Text()) {
-				filePath = fileItem->Text();
-				entry_ref file_ref;
+		if (store->IsSelected(file, line) && store->GetRef(file, &ref)) {
+			if (file != lastFile) {
+				lastFile = file;
+				BEntry entry(&ref);
 				
-				if (get_ref_for_path(filePath.String(), &file_ref) == B_OK) {
-					message.AddRef("refs", &file_ref);
+				if (entry.GetPath(&folderPath) == B_OK) {
+					message.AddRef("refs", &ref);
 					
 					// add parent folder to list of folders to open
-					folderPath.SetTo(filePath.String());
 					if (folderPath.GetParent(&folderPath) == B_OK) {
 						BPath *path = new BPath(folderPath);
 						if (path->Path() != lastFolderAddedToList) {
@@ -1236,6 +1973,8 @@ void GrepWindow::OnAboutRequested()
 void GrepWindow::OnFileDrop(BMessage *message)
 {
 	if (fModel->fState == STATE_IDLE) {
+		DiscardPausedSearch();
+
 		entry_ref directory;
 		InitRefsReceived(&directory, message);
 
@@ -1244,6 +1983,8 @@ void GrepWindow::OnFileDrop(BMessage *message)
 		fModel->fSelectedFiles = *message;
 		
 		fSearchResults->MakeEmpty();
+		fHasResumableResults = false;
+		fNarrowPattern = "";
 		
 		SetWindowTitle();
 	}
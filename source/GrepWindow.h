@@ -25,6 +25,7 @@
 
 #include <InterfaceKit.h>
 #include <FilePanel.h>
+#include <MessageRunner.h>
 
 #include "Model.h"
 #include "GrepListView.h"
@@ -57,19 +58,41 @@ class GrepWindow : public BWindow {
 		void SavePrefs();
 	
 		void OnStartCancel();
+		void DisableControls(bool live);
 		void OnSearchFinished();
-		void OnReportFileName(BMessage *message);
-		void OnReportResult(BMessage *message);
+		void OnSearchPaused(BMessage *message);
+		void EnableControls();
+		void OnLoadMore();
+		void DiscardPausedSearch();
+		void SaveResumeState();
+		void OnResumeSearch();
+		void OnSearchTimer();
+		void ShowProgress(bool showFile);
+		bool ReadResults(bigtime_t budget);
+		void AddResult(BMessage *message);
 		void OnReportError(BMessage *message);
 		void OnRecurseLinks();
 		void OnRecurseDirs();
 		void OnSkipDotDirs();
 		void OnCaseSensitive();
+		void OnWholeWord();
 		void OnEscapeText();
 		void OnTextOnly();
 		void OnInvokePe();
+		void OnLiveSearch();
+		void OnOrderedResults();
+		void OnLazyText();
+		void OnMultiLine();
+		void OnBooleanQuery();
+		void OnLiveSearchTimer();
+		void StartLiveSearch();
 		void OnCheckboxShowLines();
 		void OnMenuShowLines();
+		void OnResultMode(BMessage *message);
+		void OnMaxResults(BMessage *message);
+		void OnMaxPerFile(BMessage *message);
+		void OnContextLines(BMessage *message);
+		void OnMaxErrors(BMessage *message);
 		void OnInvokeItem();
 		void OnSearchText();
 		void OnHistoryItem(BMessage *message);
@@ -106,6 +129,8 @@ class GrepWindow : public BWindow {
 		BMenuItem *fSearch;
 		BMenuItem *fTrimSelection;
 		BMenuItem *fCopyText;
+		BMenuItem *fLoadMore;
+		BMenuItem *fResumeSearch;
 		BMenuItem *fSelectInTracker;
 		BMenuItem *fOpenSelection;
 		BMenu *fPreferencesMenu;
@@ -113,10 +138,23 @@ class GrepWindow : public BWindow {
 		BMenuItem *fRecurseDirs;
 		BMenuItem *fSkipDotDirs;
 		BMenuItem *fCaseSensitive;
+		BMenuItem *fWholeWord;
 		BMenuItem *fEscapeText;
 		BMenuItem *fTextOnly;
 		BMenuItem *fInvokePe;
+		BMenuItem *fLiveSearch;
+		BMenuItem *fOrderedResults;
+		BMenuItem *fLazyText;
+		BMenuItem *fMultiLine;
+		BMenuItem *fBooleanQuery;
 		BMenuItem *fShowLinesMenuitem;
+		BMenuItem *fResultsLines;
+		BMenuItem *fResultsFiles;
+		BMenuItem *fResultsCount;
+		BMenu *fMaxResultsMenu;
+		BMenu *fMaxPerFileMenu;
+		BMenu *fContextLinesMenu;
+		BMenu *fMaxErrorsMenu;
 		BMenu *fHistoryMenu;
 		BMenu *fEncodingMenu;
 		BMenuItem *fUTF8;
@@ -126,10 +164,43 @@ class GrepWindow : public BWindow {
 		
 		BCheckBox *fShowLinesCheckbox;
 		BButton *fButton;
+		BStringView *fStatus;
 	
 		Grepper *fGrepper;
 		BString fOldPattern;
 		
+		// Tells us to pick up results and update fStatus while searching.
+		BMessageRunner *fSearchTimer;
+		
+		// When we last updated fStatus.
+		bigtime_t fLastProgress;
+		
+		// The MSG_SEARCH_FINISHED or MSG_SEARCH_PAUSED message of the
+		// grepper, held until fSearchTimer has read all the results.
+		BMessage fSearchEnd;
+		
+		// Starts a live search once the user stops typing.
+		BMessageRunner *fLiveSearchRunner;
+		
+		// Whether the running search was started by typing.
+		bool fIsLiveSearch;
+		
+		// Whether to start another live search as soon as
+		// the cancelled one has finished.
+		bool fLiveSearchPending;
+		
+		// The row that tells the user that the search stopped at
+		// the result limit, or -1.
+		int32 fPausedFile;
+		
+		// Whether the list holds the results of the cancelled search
+		// that fModel->fResumeState refers to.
+		bool fHasResumableResults;
+		
+		// The pattern of the last search that was not cancelled.
+		// Empty if its results can't be used to narrow the next one.
+		BString fNarrowPattern;
+		
 		Model *fModel;
 		
 		BFilePanel *fFilePanel;
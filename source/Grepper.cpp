@@ -23,67 +23,536 @@
 #include <Directory.h>
 #include <List.h>
 #include <NodeInfo.h>
+#include <OS.h>
 #include <Path.h>
 #include <UTF8.h>
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
+#include "CaseFold.h"
+#include "FuzzyMatcher.h"
 #include "Grepper.h"
+#include "Matcher.h"
+#include "MultiMatcher.h"
+#include "Query.h"
+#include "ResultQueue.h"
+#include "Sanitize.h"
 
+// How many bytes we scan before we check whether we must quit.
+#define SCAN_CHUNK_SIZE (64 * 1024)
 
-char *strdup_to_utf8(uint32 encode, const char *src, int32 length)
+// Files are mapped into memory this much at a time. Each window 
+// overlaps the next by at least MAP_OVERLAP bytes, so the lines 
+// around a match near its end are still inside it.
+#define MAP_WINDOW_SIZE (64 * 1024 * 1024)
+#define MAP_OVERLAP (1024 * 1024)
+
+// A match of a regular expression can't be longer than this, so 
+// regexec() only ever looks at a small piece of the file at once.
+#define MAX_REGEX_MATCH (64 * 1024)
+
+// We never start more worker threads than this.
+#define MAX_WORKERS 16
+
+// How many result messages may wait for the window. When the 
+// queue is full, the workers block until the window takes some
+// out, so memory use stays bounded.
+#define RESULT_QUEUE_SIZE 1024
+
+// How far the workers may run ahead of the oldest file whose
+// results the window hasn't seen yet, when results are ordered.
+// Must be a power of two.
+#define REORDER_SIZE 1024
+
+// Longer lines are cut off when we report them.
+#define MAX_LINE_LENGTH 1024
+
+// We don't highlight more matches than this on one line.
+#define MAX_LINE_MATCHES 32
+
+// How grep should mark the matches on a line: only the matches 
+// themselves, so the line number and offset in front stay clean.
+#define GREP_COLORS "mt=01;31:sl=:cx=:fn=:ln=:bn=:se="
+
+extern char **environ;
+
+
+// A directory that we are traversing. It counts the entries we have
+// read from it, so that a cancelled search can be continued later on.
+class GrepDirectory : public BDirectory {
+	public:
+	
+		GrepDirectory(const entry_ref *ref) : BDirectory(ref)
+		{
+			this->ref = *ref;
+			position = 0;
+		}
+
+		status_t NextEntry(BEntry *entry, bool traverse)
+		{
+			status_t status = GetNextEntry(entry, traverse);
+			if (status == B_OK)
+				++position;
+			return status;
+		}
+		
+		// Skips the entries we already looked at. This assumes 
+		// nobody added or removed entries in the mean time.
+		void SkipTo(int32 newPosition)
+		{
+			BEntry entry;
+			while (position < newPosition 
+				&& NextEntry(&entry, false) == B_OK)
+				;
+		}
+
+		entry_ref ref;
+		int32 position;
+};
+
+
+// One of the threads that search the files.
+class GrepWorker {
+	public:
+	
+		GrepWorker(Grepper *grepper)
+		{
+			this->grepper = grepper;
+			thread = -1;
+			grepTeam = -1;
+		}
+		
+		Grepper *grepper;
+		thread_id thread;
+		
+		// The grep process that is currently running, so 
+		// that Cancel() can kill it, or -1 if there is none.
+		// Protected by the grepper's fTeamLock.
+		team_id grepTeam;
+		
+		// Where grep writes its output.
+		BPath tempFile;
+};
+
+
+// Converts "length" bytes of text to UTF-8, and returns how many bytes
+// that took in "dest". The cookie keeps the shift state of JIS between
+// the pieces of a line.
+static int32 convert_line(uint32 encode, const char *src, int32 length, 
+	char *dest, int32 room, int32 *cookie)
 {
+	if (length <= 0)
+		return 0;
+
 	int32 srcLen = length;
-	int32 dstLen = srcLen + srcLen;
-	char *dst = new char[dstLen+1];
-	int32 cookie = 0;
-	convert_to_utf8(encode, src, &srcLen, dst, &dstLen, &cookie);
-	dst[dstLen] = '\0';
-	char *dup = strdup(dst);
-	delete[] dst;
-	if (srcLen != length)
-		fprintf(stderr, "strdup_to_utf8(%ld, %ld) dst allocate smoalled(%ld)\n",
-						encode, length, dstLen);
-	return dup;
+	int32 dstLen = room;
+	if (convert_to_utf8(encode, src, &srcLen, dest, &dstLen, cookie) != B_OK)
+		return 0;
+	return dstLen;
+}
+
+
+// Returns how much of the first "length" bytes of text we can keep 
+// without cutting a double-byte character of Shift-JIS, EUC or JIS 
+// in half. We have to start at the beginning of the line, because
+// their second bytes can look like first ones.
+static int32 cut_line(uint32 encode, const char *text, int32 length)
+{
+	const uchar *src = (const uchar*) text;
+
+	// In JIS, whether we are between "ESC $ B" and "ESC ( B".
+	bool doubleByte = false;
+
+	int32 pos = 0;
+	while (pos < length) {
+		uchar c = src[pos];
+		int32 size = 1;
+
+		if (encode == B_SJIS_CONVERSION) {
+			if ((c >= 0x81 && c <= 0x9F) || (c >= 0xE0 && c <= 0xFC))
+				size = 2;
+		} else if (encode == B_EUC_CONVERSION) {
+			if (c == 0x8F)
+				size = 3;
+			else if (c >= 0x80)
+				size = 2;
+		} else if (encode == B_JIS_CONVERSION) {
+			if (c == 0x1B) {
+				size = 3;
+				if (pos + 1 < length)
+					doubleByte = (src[pos + 1] == '$');
+			} else if (doubleByte)
+				size = 2;
+		}
+
+		if (pos + size > length)
+			break;
+		pos += size;
+	}
+
+	return pos;
 }
 
 
+// Converts the pattern from UTF-8, once per search. With the escape 
+// sequences of JIS, it may grow, but never to more than three times 
+// its length.
 char *strdup_from_utf8(uint32 encode, const char *src, int32 length)
 {
 	int32 srcLen = length;
-	int32 dstLen = srcLen;
-	char *dst = new char[dstLen+1];
+	int32 dstLen = length * 3 + 3;
+	char *dst = (char*) malloc(dstLen + 1);
 	int32 cookie = 0;
 	convert_from_utf8(encode, src, &srcLen, dst, &dstLen, &cookie);
 	dst[dstLen] = '\0';
-	char *dup = strdup(dst);
-	delete[] dst;
 	if (srcLen != length)
 		fprintf(stderr, "strdup_from_utf8(%ld, %ld) dst allocate smoalled(%ld)\n",
 						encode, length, dstLen);
-	return dup;
+	return dst;
+}
+
+
+// Turns every "\\n" into a line break, in place. In literal text,
+// "\\\\" becomes a backslash; regular expressions keep it.
+static void expand_newlines(char *text, bool literal)
+{
+	char *dst = text;
+	for (const char *src = text; *src != '\0'; ++src) {
+		if (src[0] == '\\' && src[1] == 'n') {
+			*dst++ = '\n';
+			++src;
+		} else if (src[0] == '\\' && src[1] == '\\') {
+			*dst++ = '\\';
+			if (!literal)
+				*dst++ = '\\';
+			++src;
+		} else
+			*dst++ = *src;
+	}
+	*dst = '\0';
+}
+
+
+// Takes the shell quotes and backslashes off a pattern that was 
+// typed for grep, in place, so we match what grep would get.
+static void unquote_shell(char *text)
+{
+	char *dst = text;
+	char quote = '\0';
+	for (const char *src = text; *src != '\0'; ++src) {
+		char c = *src;
+		if (quote == '\'') {
+			if (c == '\'')
+				quote = '\0';
+			else
+				*dst++ = c;
+		} else if (c == '\\' && src[1] != '\0' 
+				&& (quote == '\0' || strchr("\"\\$`", src[1]) != NULL)) {
+			*dst++ = *++src;
+		} else if (c == '\'' && quote == '\0')
+			quote = '\'';
+		else if (c == '"')
+			quote = (quote == '"') ? '\0' : '"';
+		else
+			*dst++ = c;
+	}
+	*dst = '\0';
 }
 
 
-Grepper::Grepper(const char *pattern, Model *model) 
+// Whether a character can be part of a word, as grep -w sees it. 
+// Outside ASCII, we go by blocks: the ones that only hold punctuation
+// and symbols don't count, all the others are taken as letters.
+static bool is_word_char(uint32 c)
+{
+	if (c < 0x80) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') 
+			|| (c >= '0' && c <= '9') || c == '_';
+	}
+
+	if (c < 0xC0)
+		return c == 0xAA || c == 0xB5 || c == 0xBA;
+	if (c == 0xD7 || c == 0xF7)
+		return false;
+
+	return !((c >= 0x2000 && c <= 0x2BFF)
+		|| (c >= 0x3000 && c <= 0x303F)
+		|| (c >= 0xFE30 && c <= 0xFE4F)
+		|| (c >= 0xFF00 && c <= 0xFF0F)
+		|| (c >= 0xFF1A && c <= 0xFF20)
+		|| (c >= 0xFF3B && c <= 0xFF40)
+		|| (c >= 0xFF5B && c <= 0xFF65)
+		|| (c >= 0x1F000 && c <= 0x1FAFF));
+}
+
+
+// Whether the character that ends right before "text" can be part
+// of a word. Bytes that aren't UTF-8 (as in files in some other
+// encoding) count as letters if they aren't ASCII.
+static bool is_word_before(const char *data, const char *text)
+{
+	const uchar *end = (const uchar*) text;
+	const uchar *start = end - 1;
+	while (start > (const uchar*) data && end - start < 4 
+			&& (*start & 0xC0) == 0x80)
+		--start;
+
+	uint32 c;
+	if (decode_utf8(start, end, &c) != end - start)
+		return end[-1] >= 0x80;
+
+	return is_word_char(c);
+}
+
+
+// Whether the character at "text" can be part of a word.
+static bool is_word_at(const char *text, const char *dataEnd)
+{
+	uint32 c;
+	if (decode_utf8((const uchar*) text, (const uchar*) dataEnd, &c) == 0)
+		return (uchar) *text >= 0x80;
+
+	return is_word_char(c);
+}
+
+
+// Whether the text from "start" to "end" is not part of a longer 
+// word. "data" and "dataEnd" are the start and end of the file.
+static bool is_whole_word(const char *data, const char *dataEnd,
+	const char *start, const char *end)
+{
+	return (start == data || !is_word_before(data, start))
+		&& (end == dataEnd || !is_word_at(end, dataEnd));
+}
+
+
+// Returns where the line that "pos" is on starts, but doesn't look
+// further back than SCAN_CHUNK_SIZE bytes, or before "data".
+static const char *find_line_start(const char *data, const char *pos)
+{
+	const char *stop = data;
+	if (pos - data > SCAN_CHUNK_SIZE)
+		stop = pos - SCAN_CHUNK_SIZE;
+
+	while (pos > stop && pos[-1] != '\n')
+		--pos;
+	return pos;
+}
+
+
+// Returns the line break at the end of the line that "pos" is on,
+// or where we stopped looking: at "end", or SCAN_CHUNK_SIZE bytes 
+// further.
+static const char *find_line_end(const char *pos, const char *end)
+{
+	if (end - pos > SCAN_CHUNK_SIZE)
+		end = pos + SCAN_CHUNK_SIZE;
+
+	const char *lineEnd = (const char*) memchr(pos, '\n', end - pos);
+	return (lineEnd != NULL) ? lineEnd : end;
+}
+
+
+// Returns the number of line breaks from "start" to "end".
+static int32 count_lines(const char *start, const char *end)
+{
+	int32 count = 0;
+	while (start < end) {
+		start = (const char*) memchr(start, '\n', end - start);
+		if (start == NULL)
+			break;
+		++count;
+		++start;
+	}
+	return count;
+}
+
+
+// Takes the color codes that grep --color puts around matches out of 
+// a line, and returns where the matches were. Moves "end" back to 
+// the new end of the line.
+static int32 remove_colors(char *text, char **end, MatchRange *matches)
+{
+	char *src = text;
+	char *dst = text;
+	char *matchStart = NULL;
+	int32 count = 0;
+
+	while (src < *end) {
+		if (src[0] != '\33' || src + 1 >= *end || src[1] != '[') {
+			*dst++ = *src++;
+			continue;
+		}
+
+		// A match starts with "ESC[01;31m" and ends with "ESC[m";
+		// each one is followed by "ESC[K", which we skip.
+
+		char *code = src + 2;
+		while (code < *end && *code != 'm' && *code != 'K')
+			++code;
+		if (code == *end)
+			break;
+
+		if (*code == 'm') {
+			if (code > src + 2)
+				matchStart = dst;
+			else if (matchStart != NULL) {
+				if (count < MAX_LINE_MATCHES && dst > matchStart) {
+					matches[count].start = matchStart - text;
+					matches[count].length = dst - matchStart;
+					++count;
+				}
+				matchStart = NULL;
+			}
+		}
+
+		src = code + 1;
+	}
+
+	*end = dst;
+	return count;
+}
+
+
+Grepper::Grepper(const char *pattern, Model *model,
+	const BMessage *candidates) 
 {
 	fModel = model;
+
+	fNarrowing = (candidates != NULL);
+	if (fNarrowing)
+		fCandidates = *candidates;
 	
 	fThreadId = -1;
 	fMustQuit = false;
+	fPaused = false;
 	fCurrentRef = 0;
-
-	if (fModel->fEncoding) {
-		char *src = strdup_from_utf8(fModel->fEncoding, pattern, strlen(pattern));
-		SetPattern(src);
-		free(src);
+	fFilesDone = 0;
+	fBytesDone = 0;
+	fResultCount = 0;
+	fResultLimit = fModel->fMaxResults;
+
+	// Scanning is mostly limited by the CPU once the files are
+	// in the cache, so we use one worker for every processor.
+
+	system_info info;
+	get_system_info(&info);
+	int32 workerCount = info.cpu_count;
+	if (workerCount < 1)
+		workerCount = 1;
+	if (workerCount > MAX_WORKERS)
+		workerCount = MAX_WORKERS;
+
+	fWorkers = new BList(workerCount);
+	for (int32 t = 0; t < workerCount; ++t)
+		fWorkers->AddItem(new GrepWorker(this));
+
+	fPendingFiles = new BList(workerCount);
+	fResults = new ResultQueue(RESULT_QUEUE_SIZE);
+	fQueueSem = create_sem(RESULT_QUEUE_SIZE, "TrackerGrep results");
+
+	fOrdered = fModel->fOrderedResults;
+
+	// The window can only read lines back from files that are
+	// in UTF-8, because it doesn't convert them.
+	fLazyText = fModel->fLazyText && !fModel->fEncoding;
+	fNextSequence = 0;
+	fNextRelease = 0;
+	fReorderCount = 0;
+	fWorkersDone = false;
+
+	fReorderSem = create_sem(REORDER_SIZE, "TrackerGrep reorder");
+	fReorder = new ReorderSlot[REORDER_SIZE];
+	for (int32 t = 0; t < REORDER_SIZE; ++t) {
+		fReorder[t].arrived = false;
+		fReorder[t].message = NULL;
 	}
+
+	char *src;
+	if (fModel->fEncoding)
+		src = strdup_from_utf8(fModel->fEncoding, pattern, strlen(pattern));
 	else
-		SetPattern(pattern);
+		src = strdup(pattern);
+
+	SetPattern(src);
+
+	// Escaped text is a literal string, which we can find
+	// ourselves. That is a lot cheaper than starting grep 
+	// for every file, and we can stop at any moment.
+
+	// To match across lines, a "\\n" in the pattern stands for 
+	// a line break. Regular expressions are then also matched by
+	// us, because grep only looks at one line at a time.
+
+	fMatcher = NULL;
+	fRegex = NULL;
+	fQuery = NULL;
+	fWords = NULL;
+	fFuzzy = NULL;
+
+	// A query of several words is also searched by us, for all 
+	// the words at once. Text without operators stays a string.
+
+	if (fModel->fEscapeText && fModel->fBooleanQuery && !fModel->fMultiLine) {
+		fQuery = new Query(src);
+		if (fQuery->IsBoolean()) {
+			fWords = new MultiMatcher(fModel->fCaseSensitive, 
+				!fModel->fEncoding);
+			for (int32 t = 0; t < fQuery->CountTerms(); ++t)
+				fWords->AddPattern(fQuery->TermAt(t));
+			fWords->Build();
+		} else {
+			delete fQuery;
+			fQuery = NULL;
+		}
+	}
+
+	// Typos are only allowed in plain text. Patterns that Bitap
+	// can't handle are looked for without typos.
+
+	if (fModel->fEscapeText && fModel->fMaxErrors > 0 
+			&& !fModel->fMultiLine && fQuery == NULL) {
+		fFuzzy = new FuzzyMatcher(src, fModel->fMaxErrors, 
+			fModel->fCaseSensitive, !fModel->fEncoding);
+		if (fFuzzy->InitCheck() != B_OK) {
+			delete fFuzzy;
+			fFuzzy = NULL;
+		}
+	}
+
+	if (fModel->fMultiLine)
+		expand_newlines(src, fModel->fEscapeText);
 
-	fCurrentDir = new BDirectory(&fModel->fDirectory);
+	if (fModel->fMultiLine && !fModel->fEscapeText) {
+		// Without line breaks, the same text goes to grep through
+		// the shell, so we read it the way grep does.
+
+		unquote_shell(src);
+
+		fRegex = new regex_t;
+		int flags = REG_NEWLINE;
+		if (!fModel->fCaseSensitive)
+			flags |= REG_ICASE;
+
+		if (regcomp(fRegex, src, flags) != 0) {
+			// Not a valid expression; we look for it as it is.
+			delete fRegex;
+			fRegex = NULL;
+			fMatcher = new Matcher(src, fModel->fCaseSensitive, 
+				!fModel->fEncoding);
+		}
+	} else if (fModel->fEscapeText && fQuery == NULL && fFuzzy == NULL)
+		fMatcher = new Matcher(src, fModel->fCaseSensitive, 
+			!fModel->fEncoding);
+
+	free(src);
+
+	fCurrentDir = new GrepDirectory(&fModel->fDirectory);
 	fCurrentDir->Rewind();
 
 	fDirectories = new BList(10);
@@ -94,13 +563,41 @@ Grepper::Grepper(const char *pattern, Model *model)
 Grepper::~Grepper()
 {
 	free(fPattern);
+	delete fMatcher;
+	delete fQuery;
+	delete fWords;
+	delete fFuzzy;
+	if (fRegex != NULL) {
+		regfree(fRegex);
+		delete fRegex;
+	}
+
+	int32 sequence;
+	BMessage *message;
+	while (fResults->Pop(&sequence, &message))
+		DeleteResult(message);
+	delete fResults;
+	delete_sem(fQueueSem);
+	delete_sem(fReorderSem);
+
+	for (int32 t = 0; t < REORDER_SIZE; ++t)
+		DeleteResult(fReorder[t].message);
+	delete[] fReorder;
+
+	for (int32 t = fWorkers->CountItems(); t > 0; --t)
+		delete static_cast<GrepWorker*>(fWorkers->RemoveItem(t - 1));
+	delete fWorkers;
+
+	for (int32 t = fPendingFiles->CountItems(); t > 0; --t)
+		free(fPendingFiles->RemoveItem(t - 1));
+	delete fPendingFiles;
 
 	// If the thread terminated normally, then there is only 
 	// one object in the list: the initial directory. But if 
 	// the user aborted the search, there may be more.
 
 	for (int32 t = fDirectories->CountItems(); t > 0; --t) {
-		delete static_cast<BDirectory*>(fDirectories->RemoveItem((int32) 0));
+		delete static_cast<GrepDirectory*>(fDirectories->RemoveItem((int32) 0));
 	}
 
 	delete fDirectories;
@@ -118,12 +615,193 @@ void Grepper::Start()
 
 void Grepper::Cancel()
 {
+	// Don't wait for grep to finish the files it is on. A worker
+	// that starts grep after this sees fMustQuit and kills it.
+
+	fTeamLock.Lock();
 	fMustQuit = true;
+	for (int32 t = 0; t < fWorkers->CountItems(); ++t) {
+		team_id team = ((GrepWorker*) fWorkers->ItemAt(t))->grepTeam;
+		if (team >= 0)
+			kill_team(team);
+	}
+	fTeamLock.Unlock();
+
+	// Nor for the window to make room in the queue or in the 
+	// reorder buffer, because the window is about to wait for us.
+	release_sem_etc(fQueueSem, MAX_WORKERS, 0);
+	release_sem_etc(fReorderSem, MAX_WORKERS, 0);
+
 	int32 exitValue;
 	wait_for_thread(fThreadId, &exitValue);
 }
 
 
+void Grepper::Resume()
+{
+	// All our traversal state is still in fDirectories and 
+	// fCurrentRef, so a fresh thread continues with the
+	// file after the last one we looked at.
+
+	fResultLimit = fResultCount + fModel->fMaxResults;
+	Start();
+}
+
+
+status_t Grepper::GetCursor(BMessage *cursor) const
+{
+	// The first directory on the stack is always the model's
+	// directory, so we only need to know how far we got in it.
+
+	GrepDirectory *dir = (GrepDirectory*) fDirectories->FirstItem();
+	cursor->AddInt32("top_position", dir->position);
+
+	for (int32 t = 1; t < fDirectories->CountItems(); ++t) {
+		dir = (GrepDirectory*) fDirectories->ItemAt(t);
+		cursor->AddRef("dir", &dir->ref);
+		cursor->AddInt32("position", dir->position);
+	}
+
+	cursor->AddInt32("current_ref", fCurrentRef);
+	for (int32 t = 0; t < fPendingFiles->CountItems(); ++t)
+		cursor->AddString("pending_file", (char*) fPendingFiles->ItemAt(t));
+	cursor->AddInt32("files_done", fFilesDone);
+	cursor->AddInt64("bytes_done", fBytesDone);
+	cursor->AddInt32("result_count", fResultCount);
+
+	if (fNarrowing)
+		cursor->AddMessage("candidates", &fCandidates);
+
+	return B_OK;
+}
+
+
+status_t Grepper::SetCursor(const BMessage *cursor)
+{
+	int32 position;
+	if (cursor->FindInt32("top_position", &position) != B_OK)
+		return B_BAD_VALUE;
+
+	for (int32 t = fDirectories->CountItems(); t > 1; --t)
+		delete static_cast<GrepDirectory*>(fDirectories->RemoveItem(t - 1));
+
+	fCurrentDir = (GrepDirectory*) fDirectories->FirstItem();
+	fCurrentDir->Rewind();
+	fCurrentDir->position = 0;
+	fCurrentDir->SkipTo(position);
+
+	entry_ref ref;
+	for (int32 t = 0; cursor->FindRef("dir", t, &ref) == B_OK; ++t) {
+		GrepDirectory *dir = new GrepDirectory(&ref);
+
+		if (dir->InitCheck() != B_OK) {
+			// This directory has gone away since. Because its 
+			// parent is already past it, we simply forget it
+			// and everything below it.
+			delete dir;
+			break;
+		}
+
+		if (cursor->FindInt32("position", t, &position) == B_OK)
+			dir->SkipTo(position);
+
+		fDirectories->AddItem(dir);
+		fCurrentDir = dir;
+	}
+
+	cursor->FindInt32("current_ref", &fCurrentRef);
+	const char *pending;
+	for (int32 t = 0; cursor->FindString("pending_file", t, &pending) == B_OK; ++t)
+		fPendingFiles->AddItem(strdup(pending));
+	cursor->FindInt32("files_done", &fFilesDone);
+	cursor->FindInt64("bytes_done", &fBytesDone);
+	cursor->FindInt32("result_count", &fResultCount);
+	fResultLimit = fResultCount + fModel->fMaxResults;
+
+	fNarrowing = (cursor->FindMessage("candidates", &fCandidates) == B_OK);
+
+	return B_OK;
+}
+
+
+void Grepper::GetProgress(BMessage *progress)
+{
+	fProgressLock.Lock();
+	progress->AddString("file", fCurrentFile.String());
+	fProgressLock.Unlock();
+
+	progress->AddInt32("files", atomic_get(&fFilesDone));
+	progress->AddInt64("bytes", atomic_get64(&fBytesDone));
+	progress->AddInt32("results", atomic_get(&fResultCount));
+}
+
+
+bool Grepper::ReadResult(BMessage **message)
+{
+	int32 sequence;
+	BMessage *result;
+
+	while (true) {
+		if (!fOrdered) {
+			if (!PopResult(&sequence, &result))
+				return false;
+			if (result == NULL)
+				continue;
+			*message = result;
+			return true;
+		}
+
+		// Hand out the results of the next file in line, if they
+		// are here. Files without results still take their turn.
+
+		ReorderSlot *slot = &fReorder[fNextRelease & (REORDER_SIZE - 1)];
+		if (slot->arrived) {
+			result = slot->message;
+			slot->arrived = false;
+			slot->message = NULL;
+			--fReorderCount;
+			atomic_add(&fNextRelease, 1);
+			release_sem_etc(fReorderSem, 1, B_DO_NOT_RESCHEDULE);
+
+			if (result == NULL)
+				continue;
+			*message = result;
+			return true;
+		}
+
+		// Otherwise, sort whatever the workers sent us since.
+		if (PopResult(&sequence, &result)) {
+			slot = &fReorder[sequence & (REORDER_SIZE - 1)];
+			slot->arrived = true;
+			slot->message = result;
+			++fReorderCount;
+			continue;
+		}
+
+		// When the workers have quit, any files that are still
+		// missing (because of a cancel) won't come in anymore.
+		if (fWorkersDone && fReorderCount > 0) {
+			atomic_add(&fNextRelease, 1);
+			release_sem_etc(fReorderSem, 1, B_DO_NOT_RESCHEDULE);
+			continue;
+		}
+
+		return false;
+	}
+}
+
+
+bool Grepper::PopResult(int32 *sequence, BMessage **message)
+{
+	if (!fResults->Pop(sequence, message))
+		return false;
+
+	// The worker we wake up can wait until the window is done.
+	release_sem_etc(fQueueSem, 1, B_DO_NOT_RESCHEDULE);
+	return true;
+}
+
+
 int32 Grepper::SpawnThread(void *arg) 
 { 
 	return static_cast<Grepper*>(arg)->GrepperThread();
@@ -132,91 +810,1220 @@ int32 Grepper::SpawnThread(void *arg)
 
 int32 Grepper::GrepperThread() 
 {
+	fPaused = false;
+	fWorkersDone = false;
+
+	for (int32 t = 0; t < fWorkers->CountItems(); ++t) {
+		GrepWorker *worker = (GrepWorker*) fWorkers->ItemAt(t);
+		worker->thread = spawn_thread(
+			SpawnWorker, "GrepperWorker", B_NORMAL_PRIORITY, worker);
+		resume_thread(worker->thread);
+	}
+
+	for (int32 t = 0; t < fWorkers->CountItems(); ++t) {
+		GrepWorker *worker = (GrepWorker*) fWorkers->ItemAt(t);
+		status_t exitValue;
+		wait_for_thread(worker->thread, &exitValue);
+	}
+
+	// All the results are in the queue now, so the window
+	// can safely pick up the rest when it gets this message.
+
+	fWorkersDone = true;
+
 	BMessage message;
+	if (fPaused && !fMustQuit) {
+		message.what = MSG_SEARCH_PAUSED;
+		message.AddInt32("count", fResultCount);
+	} else
+		message.what = MSG_SEARCH_FINISHED;
+	fModel->fTarget->PostMessage(&message);
+
+	return 0;
+}
+
+
+int32 Grepper::SpawnWorker(void *arg) 
+{ 
+	GrepWorker *worker = static_cast<GrepWorker*>(arg);
+	return worker->grepper->WorkerThread(worker);
+}
+
 
+int32 Grepper::WorkerThread(GrepWorker *worker) 
+{
 	char fileName[B_PATH_NAME_LENGTH]; 
-	char tempString[B_PATH_NAME_LENGTH];
-	char command[B_PATH_NAME_LENGTH + 32];
-
-	BPath tempFile;
-	if (find_directory(B_SYSTEM_TEMP_DIRECTORY, &tempFile, true) != B_OK)
-		return -1;
-	sprintf(fileName, "TrackerGrep%ld", fThreadId);
-	tempFile.Append(fileName);
-
-	while (!fMustQuit && GetNextName(fileName)) {
-		message.MakeEmpty();
-		message.what = MSG_REPORT_FILE_NAME;
-		message.AddString("filename", fileName);
-		fModel->fTarget->PostMessage(&message);
-
-		message.MakeEmpty();
-		message.what = MSG_REPORT_RESULT;
-		message.AddString("filename", fileName);
+
+	bool ourselves = (fMatcher != NULL || fRegex != NULL || fQuery != NULL
+		|| fFuzzy != NULL);
+
+	if (!ourselves) {
+		if (find_directory(B_SYSTEM_TEMP_DIRECTORY, 
+				&worker->tempFile, true) != B_OK)
+			return -1;
+		sprintf(fileName, "TrackerGrep%ld", worker->thread);
+		worker->tempFile.Append(fileName);
+	}
+
+	int32 sequence;
+	while (!fMustQuit && NextFile(fileName, &sequence)) {
+		fProgressLock.Lock();
+		fCurrentFile = fileName;
+		fProgressLock.Unlock();
+
+		BMessage *message = new BMessage(MSG_REPORT_RESULT);
+		message->AddString("filename", fileName);
 		
 		BEntry entry(fileName);
 		entry_ref ref;
 		entry.GetRef(&ref);
-		message.AddRef("ref", &ref);
-
-		EscapeSpecialChars(fileName);
-
-		//assume that grep is already in $PATH
-		sprintf(
-			command, "grep -hn %s %s \"%s\" > \"%s\"",
-			fModel->fCaseSensitive ? "" : "-i", fPattern, fileName, 
-			tempFile.Path());
-
-		int res = system(command);
-
-		if (res == 0 || res == 1) {
-			FILE *results = fopen(tempFile.Path(), "r");
-
-			if (results != NULL) {
-				while (fgets(tempString, B_PATH_NAME_LENGTH, results) != 0)
-				{
-					if (fModel->fEncoding) {
-						char *tempdup = strdup_to_utf8(fModel->fEncoding, 
-							tempString, strlen(tempString));
-						message.AddString("text", tempdup);
-						free(tempdup);
-					}
-					else
-						message.AddString("text", tempString);
-				}
-				
-				if (message.HasString("text"))
-					fModel->fTarget->PostMessage(&message);
+		message->AddRef("ref", &ref);
+
+		LineBuffer lines = { NULL, 0, 0 };
+		int32 results = 0;
+		status_t status;
+		if (fQuery != NULL)
+			status = QueryFile(fileName, *message, lines, results);
+		else if (ourselves)
+			status = ScanFile(fileName, *message, lines, results);
+		else
+			status = RunGrep(fileName, worker, *message, lines, results);
+
+		// From here on, the text goes wherever the message goes.
+		if (lines.text != NULL) {
+			message->AddPointer("lines", lines.text);
+			message->AddInt32("lines_size", lines.capacity);
+		}
 
-				fclose(results);
-				continue;
-			}
+		if (status != B_OK && !fMustQuit) {
+			char error[B_PATH_NAME_LENGTH + 64];
+			sprintf(
+				error, ourselves 
+					? "%s: Could not read this file." 
+					: "%s: There was a problem running grep.",
+				fileName);
+
+			DeleteResult(message);
+			message = new BMessage(MSG_REPORT_ERROR);
+			message->AddString("error", error);
+		} else if (results == 0) {
+			DeleteResult(message);
+			message = NULL;
 		}
 
-		sprintf(
-			tempString, "%s: There was a problem running grep.",
-			fileName);
+		// When the results are ordered, the window must hear about
+		// every file, even those without results, or it would keep
+		// waiting for them.
+
+		bool deliver = (message != NULL || fOrdered);
+
+		if (fMustQuit || (deliver && !Deliver(sequence, message))) {
+			// We didn't get to report this file, so we 
+			// must do it over if the search is resumed.
+			DeleteResult(message);
+			fPendingLock.Lock();
+			fPendingFiles->AddItem(strdup(fileName));
+			fPendingLock.Unlock();
+			break;
+		}
 
-		message.MakeEmpty();
-		message.what = MSG_REPORT_ERROR;
-		message.AddString("error", tempString);
-		fModel->fTarget->PostMessage(&message);
+		atomic_add(&fFilesDone, 1);
+		atomic_add(&fResultCount, results);
 	}
 
 	// We wait with removing the temporary file until after the
 	// entire search has finished, to prevent a lot of flickering
 	// if the Tracker window for /boot/var/tmp/ might be open.
 
-	remove(tempFile.Path());
-
-	message.MakeEmpty();
-	message.what = MSG_SEARCH_FINISHED;
-	fModel->fTarget->PostMessage(&message);
+	if (!ourselves)
+		remove(worker->tempFile.Path());
 
 	return 0;
 }
 
 
+bool Grepper::NextFile(char *fileName, int32 *sequence)
+{
+	// Don't run so far ahead of the window that we overflow the
+	// reorder buffer. The semaphore counts the sequence numbers 
+	// we may still hand out, and we wait for it before we take 
+	// the lock, so the other workers can still get at that.
+
+	if (fOrdered) {
+		status_t status;
+		do {
+			status = acquire_sem(fReorderSem);
+		} while (status == B_INTERRUPTED);
+
+		if (status != B_OK || fMustQuit)
+			return false;
+	}
+
+	bool found = false;
+
+	fPendingLock.Lock();
+
+	// We check the limit before fetching the next name,
+	// so that we can resume with that file later on.
+
+	if (fModel->fMaxResults > 0 
+		&& atomic_get(&fResultCount) >= fResultLimit) {
+		fPaused = true;
+	} else if (!fPendingFiles->IsEmpty()) {
+		char *pending = (char*) fPendingFiles->RemoveItem(
+			fPendingFiles->CountItems() - 1);
+		strcpy(fileName, pending);
+		free(pending);
+		found = true;
+	} else
+		found = GetNextName(fileName);
+
+	if (found)
+		*sequence = fNextSequence++;
+
+	fPendingLock.Unlock();
+
+	if (fOrdered && !found)
+		release_sem(fReorderSem);
+
+	return found;
+}
+
+
+bool Grepper::Deliver(int32 sequence, BMessage *message)
+{
+	// The semaphore counts the free slots in the queue, so once
+	// we have one, Push() can't fail. If the window can't keep 
+	// up, we block here until it takes out a result, or until
+	// Cancel() wakes us up.
+
+	status_t status;
+	do {
+		status = acquire_sem(fQueueSem);
+	} while (status == B_INTERRUPTED);
+
+	if (status != B_OK || fMustQuit)
+		return false;
+
+	return fResults->Push(sequence, message);
+}
+
+
+const char *Grepper::FindMatch(const char *data, const char *dataEnd, 
+	const char *start, const char *end, const char **matchEnd, 
+	int32 *distance) const
+{
+	*distance = 0;
+
+	// For whole words, we simply look further when a match turns
+	// out to be part of a longer word. That is a lot cheaper than
+	// making the pattern into a regular expression.
+
+	while (start <= end) {
+		const char *found;
+
+		if (fMatcher != NULL) {
+			found = fMatcher->Find(start, end);
+			if (found == NULL)
+				return NULL;
+			*matchEnd = found + fMatcher->Length();
+		} else if (fFuzzy != NULL) {
+			found = fFuzzy->Find(start, end, matchEnd, distance);
+			if (found == NULL)
+				return NULL;
+		} else {
+			// With REG_STARTEND, the file doesn't need to end in a null
+			// byte, and we can start in the middle of it. The piece we
+			// look at is never longer than a few chunks.
+
+			regmatch_t match;
+			match.rm_so = 0;
+			match.rm_eo = end - start;
+
+			int flags = REG_STARTEND;
+			if (start > data && start[-1] != '\n')
+				flags |= REG_NOTBOL;
+
+			if (regexec(fRegex, start, 1, &match, flags) != 0)
+				return NULL;
+
+			found = start + match.rm_so;
+			*matchEnd = start + match.rm_eo;
+		}
+
+		if (!fModel->fWholeWord 
+				|| is_whole_word(data, dataEnd, found, *matchEnd))
+			return found;
+
+		start = found + 1;
+	}
+
+	return NULL;
+}
+
+
+status_t Grepper::OpenWindow(const char *fileName, FileWindow &window)
+{
+	window.map = NULL;
+	window.mapSize = 0;
+	window.offset = 0;
+	window.data = NULL;
+	window.end = NULL;
+	window.limit = NULL;
+	window.last = true;
+
+	window.fd = open(fileName, O_RDONLY);
+	if (window.fd < 0)
+		return B_ERROR;
+
+	struct stat fileStat;
+	if (fstat(window.fd, &fileStat) != 0) {
+		CloseWindow(window);
+		return B_ERROR;
+	}
+
+	window.fileSize = fileStat.st_size;
+	if (window.fileSize == 0)
+		return B_OK;
+
+	status_t status = MoveWindow(window, 0);
+	if (status != B_OK)
+		CloseWindow(window);
+	return status;
+}
+
+
+status_t Grepper::MoveWindow(FileWindow &window, off_t offset)
+{
+	if (window.map != NULL) {
+		munmap(window.map, window.mapSize);
+		window.map = NULL;
+	}
+
+	// We map the file instead of reading it, so the pages only 
+	// come in when we actually get to them. A mapping has to 
+	// start on a page boundary.
+
+	off_t mapOffset = offset - offset % B_PAGE_SIZE;
+	off_t length = window.fileSize - offset;
+	if (length > MAP_WINDOW_SIZE)
+		length = MAP_WINDOW_SIZE;
+
+	window.mapSize = (size_t) (offset - mapOffset + length);
+	void *map = mmap(NULL, window.mapSize, PROT_READ, MAP_PRIVATE, 
+		window.fd, mapOffset);
+	if (map == MAP_FAILED)
+		return B_ERROR;
+
+	window.map = map;
+	window.offset = offset;
+	window.data = (const char*) map + (offset - mapOffset);
+	window.end = window.data + length;
+	window.last = (offset + length == window.fileSize);
+	window.limit = window.last ? window.end : window.end - MAP_OVERLAP;
+	return B_OK;
+}
+
+
+void Grepper::CloseWindow(FileWindow &window)
+{
+	if (window.map != NULL)
+		munmap(window.map, window.mapSize);
+	if (window.fd >= 0)
+		close(window.fd);
+
+	window.map = NULL;
+	window.fd = -1;
+}
+
+
+status_t Grepper::ScanFile(const char *fileName, BMessage &message,
+	LineBuffer &lines, int32 &results)
+{
+	results = 0;
+
+	FileWindow window;
+	status_t status = OpenWindow(fileName, window);
+	if (status != B_OK)
+		return status;
+
+	const char *data = window.data;
+	const char *end = window.end;
+	const char *pos = data;
+	const char *counted = data;
+	int32 lineNumber = 1;
+	int32 matches = 0;
+
+	int32 perFile = fModel->fMaxPerFile;
+	if (fModel->fResultMode == RESULTS_FILES)
+		perFile = 1;
+
+	// For context lines, we remember the first line that we haven't
+	// reported yet, and how many lines after the last match still 
+	// need reporting. The window reaches back far enough that we can
+	// go back to the lines before a match without reading them again.
+
+	int32 context = 0;
+	if (fModel->fResultMode == RESULTS_LINES)
+		context = fModel->fContextLines;
+
+	const char *shown = data;
+	int32 shownNumber = 1;
+	int32 afterLeft = 0;
+	bool shownCut = false;
+
+	// Whether "pos" is on a line that we already reported, but 
+	// whose end was too far away to look for in one go.
+	bool inLine = false;
+
+	while (!fMustQuit) {
+		if (pos >= window.limit) {
+			if (window.last)
+				break;
+
+			// Move the window up to the line we are on, or to the
+			// context lines before it, so they are still in it.
+
+			const char *base = pos;
+			if (!inLine) {
+				base = find_line_start(data, pos);
+				for (int32 t = 0; t < context && base > data; ++t)
+					base = find_line_start(data, base - 1);
+			}
+
+			if (counted < base)
+				lineNumber += count_lines(counted, base);
+			else
+				lineNumber -= count_lines(base, counted);
+			counted = base;
+
+			if (afterLeft > 0 && shown < base) {
+				int32 count = count_lines(shown, base);
+				if (count > afterLeft)
+					count = afterLeft;
+
+				int32 added = AddContext(message, lines, 
+					window.offset + (shown - data), shown, base, 
+					shownNumber, count);
+				afterLeft -= added;
+				shownNumber += added;
+			}
+			if (shown < base) {
+				shown = base;
+				shownNumber = lineNumber;
+				shownCut = !inLine && base > data && base[-1] != '\n';
+			}
+
+			off_t posOffset = window.offset + (pos - data);
+			off_t shownOffset = window.offset + (shown - data);
+
+			status = MoveWindow(window, window.offset + (base - data));
+			if (status != B_OK)
+				break;
+
+			data = window.data;
+			end = window.end;
+			pos = data + (posOffset - window.offset);
+			shown = data + (shownOffset - window.offset);
+			counted = data;
+			continue;
+		}
+
+		// Look at one chunk at a time, so we notice quickly that 
+		// the user cancelled, even in the middle of a huge file.
+
+		const char *chunkEnd = window.limit;
+		if (chunkEnd - pos > SCAN_CHUNK_SIZE)
+			chunkEnd = pos + SCAN_CHUNK_SIZE;
+
+		if (inLine) {
+			const char *newline = (const char*) 
+				memchr(pos, '\n', chunkEnd - pos);
+			const char *next = (newline != NULL) ? newline + 1 : chunkEnd;
+			atomic_add64(&fBytesDone, next - pos);
+			pos = shown = next;
+			inLine = (newline == NULL);
+			continue;
+		}
+
+		// A match may start in this chunk and end in the next one.
+
+		int32 longest = MAX_REGEX_MATCH;
+		if (fMatcher != NULL)
+			longest = fMatcher->Length();
+		else if (fFuzzy != NULL)
+			longest = fFuzzy->MaxLength();
+
+		const char *searchEnd = chunkEnd + longest - 1;
+		if (searchEnd > end)
+			searchEnd = end;
+
+		const char *matchEnd;
+		int32 distance;
+		const char *match = FindMatch(data, end, pos, searchEnd, &matchEnd,
+			&distance);
+		if (match == NULL) {
+			atomic_add64(&fBytesDone, chunkEnd - pos);
+			pos = chunkEnd;
+			continue;
+		}
+
+		// A regular expression may match past the chunk, where its
+		// match could be cut short. The next search starts there.
+
+		if (match >= chunkEnd) {
+			atomic_add64(&fBytesDone, match - pos);
+			pos = match;
+			continue;
+		}
+
+		const char *lineStart = find_line_start(data, match);
+
+		// In multi-line mode, the match may end a few lines further.
+		// A line that doesn't end within SCAN_CHUNK_SIZE bytes is 
+		// cut off there; we skip the rest of it later, a chunk at a 
+		// time.
+
+		const char *last = (matchEnd > match) ? matchEnd - 1 : match;
+		const char *lineEnd = find_line_end(last, end);
+		bool cut = (lineEnd < end) ? *lineEnd != '\n' : !window.last;
+
+		if (counted < lineStart)
+			lineNumber += count_lines(counted, lineStart);
+		counted = lineStart;
+
+		if (context > 0) {
+			// If we moved the window to the middle of a long line, 
+			// the rest of that line isn't shown.
+
+			if (shownCut && shown < lineStart) {
+				const char *newline = (const char*) 
+					memchr(shown, '\n', lineStart - shown);
+				if (newline != NULL) {
+					shown = newline + 1;
+					++shownNumber;
+				} else
+					shown = lineStart;
+				shownCut = false;
+			}
+
+			// If the lines after the last match run into the lines
+			// before this one, we report them all just once.
+
+			int32 gap = lineNumber - shownNumber;
+			if (gap <= afterLeft + context) {
+				AddContext(message, lines, window.offset + (shown - data), 
+					shown, lineStart, shownNumber, gap);
+			} else {
+				AddContext(message, lines, window.offset + (shown - data), 
+					shown, lineStart, shownNumber, afterLeft);
+
+				// Lines too long to find their start aren't shown.
+				const char *before = lineStart;
+				int32 count = 0;
+				while (count < context && before > data 
+						&& before[-1] == '\n') {
+					const char *start = find_line_start(data, before - 1);
+					if (start > data && start[-1] != '\n')
+						break;
+					before = start;
+					++count;
+				}
+
+				AddContext(message, lines, window.offset + (before - data), 
+					before, lineStart, lineNumber - count, count);
+			}
+		}
+
+		int32 lineCount = 1;
+
+		if (fModel->fResultMode == RESULTS_LINES 
+				&& memchr(match, '\n', last - match) == NULL) {
+			// Find the other matches on this line, so the window 
+			// can highlight them without searching again. With typos,
+			// the line gets the fewest typos of any of its matches.
+
+			MatchRange matches[MAX_LINE_MATCHES];
+			int32 matchCount = 0;
+			int32 more = distance;
+
+			for (const char *found = match; found != NULL 
+					&& matchCount < MAX_LINE_MATCHES
+					&& found - lineStart < MAX_LINE_LENGTH; 
+					found = FindMatch(data, end, matchEnd, lineEnd, &matchEnd, 
+						&more)) {
+				if (more < distance)
+					distance = more;
+
+				const char *stop = (matchEnd < lineEnd) ? matchEnd : lineEnd;
+				if (stop - lineStart > MAX_LINE_LENGTH)
+					break;
+
+				matches[matchCount].start = found - lineStart;
+				matches[matchCount].length = stop - found;
+				++matchCount;
+
+				// An empty match would keep matching at the same spot.
+				if (matchEnd == found)
+					break;
+			}
+
+			AddLine(message, lines, lineNumber, 
+				window.offset + (lineStart - data), lineStart, lineEnd, 
+				matches, matchCount, false, distance);
+		} else if (fModel->fResultMode == RESULTS_LINES) {
+			// A match across lines is reported as all of its lines,
+			// with the part of the match on each of them.
+
+			lineCount = 0;
+			for (const char *start = lineStart; start <= last; ) {
+				const char *stop = (const char*) 
+					memchr(start, '\n', lineEnd - start);
+				if (stop == NULL)
+					stop = lineEnd;
+
+				const char *from = (match > start) ? match : start;
+				const char *to = (matchEnd < stop) ? matchEnd : stop;
+
+				MatchRange range;
+				range.start = from - start;
+				range.length = to - from;
+				int32 rangeCount = (to - start <= MAX_LINE_LENGTH) ? 1 : 0;
+
+				AddLine(message, lines, lineNumber + lineCount, 
+					window.offset + (start - data), start, stop, &range, 
+					rangeCount, false);
+
+				++lineCount;
+				start = stop + 1;
+			}
+		}
+
+		// Like grep, we report each line only once.
+		const char *next = lineEnd;
+		if (!cut && lineEnd < end)
+			++next;
+
+		shown = next;
+		shownNumber = lineNumber + lineCount;
+		shownCut = false;
+		afterLeft = context;
+		inLine = cut;
+
+		atomic_add64(&fBytesDone, next - pos);
+		pos = next;
+
+		++matches;
+		if (perFile > 0 && matches >= perFile)
+			break;
+	}
+
+	if (afterLeft > 0 && !inLine && !shownCut && !fMustQuit 
+			&& status == B_OK) {
+		AddContext(message, lines, window.offset + (shown - data), shown, 
+			end, shownNumber, afterLeft);
+	}
+
+	CloseWindow(window);
+
+	if (fMustQuit)
+		return B_CANCELED;
+	if (status != B_OK)
+		return status;
+
+	switch (fModel->fResultMode) {
+		case RESULTS_FILES:
+			results = (matches > 0) ? 1 : 0;
+			break;
+		case RESULTS_COUNT:
+			if (matches > 0) {
+				message.AddInt32("count", matches);
+				results = 1;
+			}
+			break;
+		default:
+			results = matches;
+			break;
+	}
+
+	return B_OK;
+}
+
+
+status_t Grepper::QueryFile(const char *fileName, BMessage &message,
+	LineBuffer &lines, int32 &results)
+{
+	results = 0;
+
+	FileWindow window;
+	status_t status = OpenWindow(fileName, window);
+	if (status != B_OK)
+		return status;
+
+	const char *data = window.data;
+	const char *end = window.end;
+	const char *pos = data;
+	const char *counted = data;
+	int32 lineNumber = 1;
+	int32 matches = 0;
+
+	// Unless we only list files, we look for the lines with the 
+	// words that make a file match. The automaton finds the words
+	// in the order in which they end, so we gather all of them on
+	// a line before we add it.
+
+	bool wantLines = (fModel->fResultMode != RESULTS_FILES);
+	uint32 positive = fQuery->PositiveTerms();
+	int32 perFile = fModel->fMaxPerFile;
+
+	const char *lineStart = NULL;
+	const char *lineEnd = NULL;
+	MatchRange ranges[MAX_LINE_MATCHES];
+	int32 rangeCount = 0;
+
+	// If a line was too long to find its end, this is how far we
+	// know it goes; words before the next line break are ignored.
+	const char *cutLine = NULL;
+
+	uint32 found = 0;
+	int32 state = 0;
+	int32 verdict = QUERY_UNKNOWN;
+
+	while (!fMustQuit) {
+		// Once we know the answer, we only go on for the lines.
+		if (verdict == QUERY_FALSE)
+			break;
+		if (verdict == QUERY_TRUE 
+				&& (!wantLines || (perFile > 0 && matches >= perFile)))
+			break;
+
+		if (pos >= window.limit && window.last) {
+			verdict = fQuery->Evaluate(found, true);
+			break;
+		}
+
+		if (pos >= window.limit) {
+			// Move the window up. The line we are gathering words for
+			// must stay in it; if we are past that line, add it now.
+
+			if (lineStart != NULL && pos > lineEnd) {
+				if (fModel->fResultMode == RESULTS_LINES) {
+					AddLine(message, lines, lineNumber, 
+						window.offset + (lineStart - data), lineStart, 
+						lineEnd, ranges, rangeCount, false);
+				}
+				++matches;
+				lineStart = NULL;
+			}
+
+			if (cutLine != NULL && cutLine < pos) {
+				if (memchr(cutLine, '\n', pos - cutLine) != NULL)
+					cutLine = NULL;
+				else
+					cutLine = pos;
+			}
+
+			// A word that ends in the new window may have started
+			// before "pos", but not before the line it is on.
+
+			const char *base = lineStart;
+			if (base == NULL)
+				base = find_line_start(data, pos);
+
+			if (counted < base)
+				lineNumber += count_lines(counted, base);
+			else
+				lineNumber -= count_lines(base, counted);
+			counted = base;
+
+			off_t baseOffset = window.offset + (base - data);
+			off_t posOffset = window.offset + (pos - data);
+			off_t lineEndOffset = 0;
+			if (lineStart != NULL)
+				lineEndOffset = window.offset + (lineEnd - data);
+			off_t cutOffset = 0;
+			if (cutLine != NULL)
+				cutOffset = window.offset + (cutLine - data);
+
+			status = MoveWindow(window, baseOffset);
+			if (status != B_OK)
+				break;
+
+			data = window.data;
+			end = window.end;
+			pos = data + (posOffset - baseOffset);
+			counted = data;
+			if (lineStart != NULL) {
+				lineStart = data;
+				lineEnd = data + (lineEndOffset - baseOffset);
+			}
+			if (cutLine != NULL)
+				cutLine = data + (cutOffset - baseOffset);
+			continue;
+		}
+
+		const char *chunkEnd = window.limit;
+		if (chunkEnd - pos > SCAN_CHUNK_SIZE)
+			chunkEnd = pos + SCAN_CHUNK_SIZE;
+
+		// The automaton folds whole UTF-8 characters, so 
+		// we don't cut one in half.
+		while (!fModel->fEncoding && chunkEnd < end 
+				&& (*chunkEnd & 0xC0) == 0x80)
+			++chunkEnd;
+
+		uint32 hits;
+		const char *hit = fWords->Scan(pos, chunkEnd, &state, &hits);
+		if (hit == NULL) {
+			atomic_add64(&fBytesDone, chunkEnd - pos);
+			pos = chunkEnd;
+			continue;
+		}
+
+		atomic_add64(&fBytesDone, hit - pos);
+		pos = hit;
+
+		if (fModel->fWholeWord) {
+			for (int32 t = 0; t < MAX_PATTERNS; ++t) {
+				if ((hits & ((uint32) 1 << t)) != 0 && !is_whole_word(data, end, 
+						hit - fWords->Length(t), hit))
+					hits &= ~((uint32) 1 << t);
+			}
+		}
+
+		if ((hits & ~found) != 0) {
+			found |= hits;
+			verdict = fQuery->Evaluate(found, false);
+		}
+
+		hits &= positive;
+		if (!wantLines || hits == 0)
+			continue;
+
+		// The words don't contain line breaks, so all the words 
+		// that end here are on the same line.
+
+		if (lineStart != NULL && hit > lineEnd) {
+			if (fModel->fResultMode == RESULTS_LINES) {
+				AddLine(message, lines, lineNumber, 
+					window.offset + (lineStart - data), lineStart, lineEnd, 
+					ranges, rangeCount, false);
+			}
+			++matches;
+			lineStart = NULL;
+		}
+
+		if (cutLine != NULL && hit > cutLine) {
+			if (memchr(cutLine, '\n', hit - cutLine) == NULL) {
+				cutLine = hit;
+				continue;
+			}
+			cutLine = NULL;
+		}
+
+		if (lineStart == NULL) {
+			if (perFile > 0 && matches >= perFile)
+				continue;
+
+			lineStart = find_line_start(data, hit - 1);
+			lineEnd = find_line_end(hit, end);
+			if ((lineEnd < end) ? *lineEnd != '\n' : !window.last)
+				cutLine = lineEnd;
+
+			if (counted < lineStart)
+				lineNumber += count_lines(counted, lineStart);
+			counted = lineStart;
+			rangeCount = 0;
+		}
+
+		for (int32 t = 0; t < MAX_PATTERNS; ++t) {
+			if ((hits & ((uint32) 1 << t)) == 0)
+				continue;
+
+			int32 from = hit - fWords->Length(t) - lineStart;
+			int32 to = hit - lineStart;
+			if (to > MAX_LINE_LENGTH)
+				break;
+
+			// This range ends after all the others, but may overlap
+			// some of them; then it swallows those.
+
+			while (rangeCount > 0 && ranges[rangeCount - 1].start 
+					+ ranges[rangeCount - 1].length > from) {
+				--rangeCount;
+				if (ranges[rangeCount].start < from)
+					from = ranges[rangeCount].start;
+			}
+
+			if (rangeCount < MAX_LINE_MATCHES) {
+				ranges[rangeCount].start = from;
+				ranges[rangeCount].length = to - from;
+				++rangeCount;
+			}
+		}
+	}
+
+	if (lineStart != NULL && verdict == QUERY_TRUE && !fMustQuit 
+			&& status == B_OK) {
+		if (fModel->fResultMode == RESULTS_LINES) {
+			AddLine(message, lines, lineNumber, 
+				window.offset + (lineStart - data), lineStart, lineEnd, 
+				ranges, rangeCount, false);
+		}
+		++matches;
+	}
+
+	CloseWindow(window);
+
+	if (fMustQuit)
+		return B_CANCELED;
+	if (status != B_OK)
+		return status;
+
+	// If the file doesn't match, the lines we gathered before we
+	// knew that are thrown away along with the message.
+
+	if (verdict != QUERY_TRUE)
+		return B_OK;
+
+	switch (fModel->fResultMode) {
+		case RESULTS_FILES:
+			results = 1;
+			break;
+		case RESULTS_COUNT:
+			message.AddInt32("count", matches);
+			results = 1;
+			break;
+		default:
+			// A file may match without any lines to show,
+			// for instance when the query is only a NOT.
+			results = (matches > 0) ? matches : 1;
+			break;
+	}
+
+	return B_OK;
+}
+
+
+status_t Grepper::RunGrep(const char *fileName, GrepWorker *worker,
+	BMessage &message, LineBuffer &lines, int32 &results)
+{
+	results = 0;
+
+	char escapedName[B_PATH_NAME_LENGTH * 2];
+	strcpy(escapedName, fileName);
+	EscapeSpecialChars(escapedName);
+
+	// When we only want to know which files match, grep -q stops 
+	// reading at the first match. With -c, grep only tells us how
+	// many lines match, so we don't have to read them all back.
+
+	const char *options;
+	switch (fModel->fResultMode) {
+		case RESULTS_FILES:
+			options = "-q";
+			break;
+		case RESULTS_COUNT:
+			options = "-hc";
+			break;
+		default:
+			options = "-hnb";
+			break;
+	}
+
+	// In color, grep shows us where the matches are on each line.
+
+	BString command;
+	command << "exec grep " << options;
+	if (fModel->fResultMode == RESULTS_LINES)
+		command.Prepend("GREP_COLORS='" GREP_COLORS "' ").Append(" --color=always");
+	if (fModel->fMaxPerFile > 0 && fModel->fResultMode != RESULTS_FILES)
+		command << " -m " << fModel->fMaxPerFile;
+	if (fModel->fContextLines > 0 && fModel->fResultMode == RESULTS_LINES)
+		command << " -C " << fModel->fContextLines;
+	if (!fModel->fCaseSensitive)
+		command << " -i";
+	if (fModel->fWholeWord)
+		command << " -w";
+	command << " " << fPattern << " \"" << escapedName << "\" > \"" 
+		<< worker->tempFile.Path() << "\"";
+
+	// Unlike system(), this gives us the team of the grep process,
+	// so Cancel() can kill it. Because of the "exec", the shell 
+	// turns into grep instead of starting it as a child.
+
+	const char *args[] = { "/bin/sh", "-c", command.String(), NULL };
+	team_id team = load_image(3, args, (const char**) environ);
+	if (team < 0)
+		return B_ERROR;
+
+	// If Cancel() already went through the workers, it didn't see
+	// this team, so we kill it ourselves.
+
+	fTeamLock.Lock();
+	worker->grepTeam = team;
+	bool quit = fMustQuit;
+	fTeamLock.Unlock();
+
+	if (quit)
+		kill_team(team);
+
+	status_t res;
+	resume_thread(team);
+	wait_for_thread(team, &res);
+
+	fTeamLock.Lock();
+	worker->grepTeam = -1;
+	fTeamLock.Unlock();
+
+	if (fMustQuit)
+		return B_CANCELED;
+
+	if (res != 0 && res != 1)
+		return B_ERROR;
+
+	struct stat fileStat;
+	if (stat(fileName, &fileStat) == 0)
+		atomic_add64(&fBytesDone, fileStat.st_size);
+
+	if (fModel->fResultMode == RESULTS_FILES) {
+		results = (res == 0) ? 1 : 0;
+		return B_OK;
+	}
+
+	FILE *file = fopen(worker->tempFile.Path(), "r");
+	if (file == NULL)
+		return B_ERROR;
+
+	// With colors, a line from grep has more in it than just text.
+	char line[MAX_LINE_LENGTH * 4];
+
+	if (fModel->fResultMode == RESULTS_COUNT) {
+		if (fgets(line, sizeof(line), file) != 0) {
+			int32 count = atol(line);
+			if (count > 0) {
+				message.AddInt32("count", count);
+				results = 1;
+			}
+		}
+	} else {
+		while (fgets(line, sizeof(line), file) != 0) {
+			char *end = line + strlen(line);
+			if (end > line && end[-1] == '\n')
+				--end;
+			else {
+				// The line was too long for us; skip the rest.
+				int c;
+				while ((c = fgetc(file)) != EOF && c != '\n')
+					;
+			}
+
+			// With -C, grep puts "--" between groups of lines
+			// that are not next to each other.
+			if (strcmp(line, "--\n") == 0)
+				continue;
+
+			// With -n and -b, grep puts the line number and 
+			// the offset of the line in front of the text, 
+			// followed by ':', or by '-' for context lines. 
+			// Options in the pattern may have changed that.
+
+			int32 lineNumber = 0;
+			off_t offset = -1;
+			bool context = false;
+			char *text = line;
+			char *first = line + strspn(line, "0123456789");
+			if (first > line && (*first == ':' || *first == '-')) {
+				char *second = first + 1 + strspn(first + 1, "0123456789");
+				if (second > first + 1 && *second == *first) {
+					lineNumber = atol(line);
+					offset = strtoll(first + 1, NULL, 10);
+					context = (*first == '-');
+					text = second + 1;
+				}
+			}
+
+			MatchRange matches[MAX_LINE_MATCHES];
+			int32 matchCount = remove_colors(text, &end, matches);
+
+			AddLine(message, lines, lineNumber, offset, text, end,
+				matches, matchCount, context);
+			if (!context)
+				++results;
+		}
+	}
+
+	fclose(file);
+	return B_OK;
+}
+
+
+void Grepper::AddLine(BMessage &message, LineBuffer &lines, 
+	int32 lineNumber, off_t offset, const char *start, const char *end,
+	const MatchRange *matches, int32 matchCount, bool context, 
+	int32 distance)
+{
+	int32 length = end - start;
+	if (length > MAX_LINE_LENGTH) {
+		length = MAX_LINE_LENGTH;
+
+		// Don't cut a character in half.
+		if (!fModel->fEncoding) {
+			while (length > 0 && (start[length] & 0xC0) == 0x80)
+				--length;
+		} else
+			length = cut_line(fModel->fEncoding, start, length);
+	}
+
+	// Matches in the part we cut off are of no use.
+
+	while (matchCount > 0 
+		&& matches[matchCount - 1].start + matches[matchCount - 1].length 
+			> length)
+		--matchCount;
+
+	message.AddInt32("line", lineNumber);
+	message.AddInt64("offset", offset);
+	message.AddBool("context", context);
+	if (fFuzzy != NULL)
+		message.AddInt32("distance", distance);
+
+	// Without an offset, the window can't find the line again,
+	// so we have to send its text after all.
+
+	int32 text = -1;
+	MatchRange converted[MAX_LINE_MATCHES];
+
+	if (fLazyText && offset >= 0) {
+		// Nothing to do; the window reads the text later.
+	} else if (fModel->fEncoding) {
+		// We searched the file as it is, so only the lines we report 
+		// get converted to UTF-8, straight into "lines". A byte never 
+		// takes more than three in UTF-8 (half-width katakana do). We 
+		// convert the line piece by piece, so we learn where the 
+		// matches end up.
+
+		int32 room = length * 3;
+		text = AddToLines(lines, NULL, room + 1, 1);
+		if (text >= 0) {
+			char *dest = lines.text + text;
+			int32 cookie = 0;
+			int32 done = 0;
+			int32 size = 0;
+
+			if (matchCount > MAX_LINE_MATCHES)
+				matchCount = MAX_LINE_MATCHES;
+
+			for (int32 t = 0; t < matchCount; ++t) {
+				int32 from = matches[t].start;
+				if (from < done)
+					from = done;
+				int32 to = matches[t].start + matches[t].length;
+				if (to < from)
+					to = from;
+
+				size += convert_line(fModel->fEncoding, start + done, 
+					from - done, dest + size, room - size, &cookie);
+				converted[t].start = size;
+				size += convert_line(fModel->fEncoding, start + from, 
+					to - from, dest + size, room - size, &cookie);
+				converted[t].length = size - converted[t].start;
+				done = to;
+			}
+
+			size += convert_line(fModel->fEncoding, start + done, 
+				length - done, dest + size, room - size, &cookie);
+
+			sanitize_text(dest, dest, size);
+			dest[size] = '\0';
+
+			// Give back the room we didn't need.
+			lines.size = text + size + 1;
+			length = size;
+			matches = converted;
+		} else
+			length = 0;
+	} else {
+		// We clean up the text here, so the window doesn't have to
+		// look at it at all. It also takes the text over as it is.
+
+		text = AddToLines(lines, NULL, length + 1, 1);
+		if (text >= 0) {
+			sanitize_text(lines.text + text, start, length);
+			lines.text[text + length] = '\0';
+		} else
+			length = 0;
+	}
+
+	message.AddInt32("length", length);
+	message.AddInt32("text", text);
+	message.AddInt32("match_count", matchCount);
+	message.AddInt32("matches", matchCount > 0 
+		? AddToLines(lines, matches, matchCount * sizeof(MatchRange), 
+			sizeof(uint16))
+		: -1);
+}
+
+
+int32 Grepper::AddToLines(LineBuffer &lines, const void *data, int32 size,
+	int32 alignment)
+{
+	int32 pos = (lines.size + alignment - 1) / alignment * alignment;
+
+	if (pos + size > lines.capacity) {
+		int32 capacity = (lines.capacity == 0) ? 4096 : lines.capacity * 2;
+		while (pos + size > capacity)
+			capacity *= 2;
+
+		char *text = (char*) realloc(lines.text, capacity);
+		if (text == NULL)
+			return -1;
+
+		lines.text = text;
+		lines.capacity = capacity;
+	}
+
+	if (data != NULL)
+		memcpy(lines.text + pos, data, size);
+
+	lines.size = pos + size;
+	return pos;
+}
+
+
+int32 Grepper::AddContext(BMessage &message, LineBuffer &lines, 
+	off_t offset, const char *start, const char *end, int32 lineNumber, 
+	int32 count)
+{
+	const char *first = start;
+	int32 t;
+	for (t = 0; t < count && start < end; ++t) {
+		const char *lineEnd = (const char*) memchr(start, '\n', end - start);
+		if (lineEnd == NULL)
+			lineEnd = end;
+
+		AddLine(message, lines, lineNumber + t, offset + (start - first), 
+			start, lineEnd, NULL, 0, true);
+
+		start = lineEnd + 1;
+	}
+	return t;
+}
+
+
+void Grepper::DeleteResult(BMessage *message)
+{
+	if (message == NULL)
+		return;
+
+	void *lines;
+	if (message->FindPointer("lines", &lines) == B_OK)
+		free(lines);
+
+	delete message;
+}
+
+
 void Grepper::SetPattern(const char *src)
 {
 	if (fModel->fEscapeText) {
@@ -326,22 +2133,25 @@ bool Grepper::GetTopEntry(BEntry &entry)
 	// at the "refs" inside the message that was passed into 
 	// our add-on's process_refs(). If the user didn't select 
 	// any files, we will simply read all the entries from the 
-	// current working directory.
+	// current working directory. When narrowing down a previous
+	// search, we only look at the files that matched last time.
+	
+	const BMessage *refs = fNarrowing
+		? &fCandidates : &fModel->fSelectedFiles;
 	
 	entry_ref fileRef;
 
-	if (fModel->fSelectedFiles.FindRef("refs",
-		fCurrentRef, &fileRef) == B_OK) {
+	if (refs->FindRef("refs", fCurrentRef, &fileRef) == B_OK) {
 		entry.SetTo(&fileRef, fModel->fRecurseLinks);
 		++fCurrentRef;
 		return true;
-	} else if (fCurrentRef > 0) {
+	} else if (fCurrentRef > 0 || fNarrowing) {
 		// when we get here, we have processed
 		// all the refs from the message
 		return false;
 	} else {
 		// examine the whole directory
-		return fCurrentDir->GetNextEntry(&entry,
+		return fCurrentDir->NextEntry(&entry,
 			fModel->fRecurseLinks) == B_OK;
 	}
 }
@@ -349,13 +2159,13 @@ bool Grepper::GetTopEntry(BEntry &entry)
 
 bool Grepper::GetSubEntry(BEntry &entry)
 {
-	if (fCurrentDir->GetNextEntry(&entry, fModel->fRecurseLinks) != B_OK) {
+	if (fCurrentDir->NextEntry(&entry, fModel->fRecurseLinks) != B_OK) {
 		// If we get here, there are no more entries in 
 		// this subdir, so return to the parent directory.
 
 		fDirectories->RemoveItem(fCurrentDir);
 		delete fCurrentDir;
-		fCurrentDir = (BDirectory*) fDirectories->LastItem();
+		fCurrentDir = (GrepDirectory*) fDirectories->LastItem();
 	
 		return GetNextEntry(entry);
 	}
@@ -375,7 +2185,11 @@ void Grepper::ExamineSubdir(BEntry &entry)
 			}
 		}
 
-		BDirectory *dir = new BDirectory(&entry);
+		entry_ref ref;
+		if (entry.GetRef(&ref) != B_OK)
+			return;
+
+		GrepDirectory *dir = new GrepDirectory(&ref);
 
 		if (dir->InitCheck() == B_OK) {
 			// Add new directory to the list 
@@ -23,25 +23,171 @@
 #ifndef __GREPPER_H__
 #define __GREPPER_H__
 
+#include <Locker.h>
+#include <String.h>
+
+#include <regex.h>
+
 #include "Model.h"
 
-// Executes "grep" in a background thread.
+class GrepDirectory;
+class GrepWorker;
+class FuzzyMatcher;
+class Matcher;
+class MultiMatcher;
+class Query;
+class ResultQueue;
+
+// Searches files in background threads. Literal patterns are 
+// looked for in-process; regular expressions are handed to "grep".
 class Grepper {
 	public:
 	
-		Grepper(const char *pattern, Model *model);
+		// If "candidates" is given, only the files in its "refs"
+		// array are searched, instead of the model's target.
+		Grepper(const char *pattern, Model *model,
+			const BMessage *candidates = NULL);
 		virtual ~Grepper();
 	
 		void Start();
 		void Cancel(); 
+		
+		// Continues a search that paused because it reached 
+		// the model's result limit, from the exact same spot.
+		void Resume();
+		
+		// Stores how far the search got into "cursor", so that a 
+		// new Grepper can continue from there, even after a restart.
+		// Only call this while the grepper thread is not running.
+		status_t GetCursor(BMessage *cursor) const;
+		
+		// Picks up the traversal where GetCursor() left off. 
+		// Call this before Start().
+		status_t SetCursor(const BMessage *cursor);
+		
+		// Fills "progress" with the file we are searching ("file"), 
+		// and how many files ("files"), bytes ("bytes") and results 
+		// ("results") we have done so far. Safe to call at any time; 
+		// the window polls this instead of us telling it every file.
+		void GetProgress(BMessage *progress);
+		
+		// Takes the next result message out of our queue, or returns 
+		// false if there is none yet. The caller must delete the 
+		// message. Only the window's thread may call this; it should
+		// keep doing so until it gets MSG_SEARCH_FINISHED or 
+		// MSG_SEARCH_PAUSED, and then once more.
+		bool ReadResult(BMessage **message);
 	
 	private:
 	
 		// Spawns the real grepper thread.
 		static int32 SpawnThread(void *arg);
 	
-		// The thread function that does the actual grepping.
+		// Starts the workers and waits until they are all done.
 		int32 GrepperThread(); 
+		
+		// Spawns a worker thread.
+		static int32 SpawnWorker(void *arg);
+		
+		// The thread function that does the actual grepping. 
+		// Several of these run at the same time.
+		int32 WorkerThread(GrepWorker *worker);
+		
+		// Hands out the next file to a worker, and numbers it in 
+		// the order in which we found it. Returns false if there 
+		// are no more, or if we reached the result limit.
+		bool NextFile(char *fileName, int32 *sequence);
+		
+		// Puts a result message in the queue, waiting for the window
+		// if necessary. Returns false if we were cancelled first.
+		bool Deliver(int32 sequence, BMessage *message);
+		
+		// Takes a message out of the queue, and lets a worker
+		// that waits in Deliver() go on.
+		bool PopResult(int32 *sequence, BMessage **message);
+		
+		// The text of the matching lines in one file. The window
+		// takes it over as it is, without copying it.
+		struct LineBuffer {
+			char *text;
+			int32 size;
+			int32 capacity;
+		};
+		
+		// Finds the first match between "start" and "end", with 
+		// fMatcher, fFuzzy or fRegex, and sets "matchEnd" to where it
+		// ends and "distance" to the number of typos in it.
+		// "data" and "dataEnd" are the start and end of the window.
+		const char *FindMatch(const char *data, const char *dataEnd,
+			const char *start, const char *end, 
+			const char **matchEnd, int32 *distance) const;
+		
+		// The part of a file that we have mapped into memory. Big 
+		// files are searched one window at a time, so they never need
+		// more address space than MAP_WINDOW_SIZE.
+		struct FileWindow {
+			int fd;
+			off_t fileSize;
+			void *map;
+			size_t mapSize;
+			off_t offset;       // where "data" is in the file
+			const char *data;   // NULL if the file is empty
+			const char *end;
+			const char *limit;  // where we should move on
+			bool last;          // whether "end" is the end of the file
+		};
+		
+		// Opens a file and maps its first window.
+		status_t OpenWindow(const char *fileName, FileWindow &window);
+		
+		// Maps the window that starts at "offset" instead.
+		status_t MoveWindow(FileWindow &window, off_t offset);
+		
+		// Unmaps the window and closes the file.
+		void CloseWindow(FileWindow &window);
+		
+		// Searches one file with FindMatch() and adds what we 
+		// found to "message" and "lines". Returns B_CANCELED if we had
+		// to quit halfway, and sets "results" to the number of results
+		// (lines, or files) that should be reported.
+		status_t ScanFile(const char *fileName, BMessage &message,
+			LineBuffer &lines, int32 &results);
+		
+		// Like ScanFile(), but decides with fQuery whether the file 
+		// matches. The lines we report are those with words that 
+		// aren't under a NOT.
+		status_t QueryFile(const char *fileName, BMessage &message,
+			LineBuffer &lines, int32 &results);
+		
+		// Like ScanFile(), but lets grep do the work.
+		status_t RunGrep(const char *fileName, GrepWorker *worker, 
+			BMessage &message, LineBuffer &lines, int32 &results);
+		
+		// Adds a matching line to "message": its number, where it 
+		// starts in the file, and where its text (without the newline,
+		// and with control characters made into spaces) and the places
+		// on the line that matched are in "lines". Context lines are
+		// the lines around a match that we show with it. "distance" is
+		// the number of typos, when we allow those.
+		void AddLine(BMessage &message, LineBuffer &lines, int32 lineNumber,
+			off_t offset, const char *start, const char *end,
+			const MatchRange *matches, int32 matchCount, bool context,
+			int32 distance = 0);
+		
+		// Adds up to "count" context lines, starting with the line 
+		// at "start" and stopping at "end". "offset" is where "start"
+		// is in the file. Returns how many lines it added.
+		int32 AddContext(BMessage &message, LineBuffer &lines, 
+			off_t offset, const char *start, const char *end, 
+			int32 lineNumber, int32 count);
+		
+		// Makes room for "size" bytes in "lines", copies "data" there
+		// unless it is NULL, and returns where it went, or -1.
+		int32 AddToLines(LineBuffer &lines, const void *data, int32 size,
+			int32 alignment);
+		
+		// Deletes a result message and the text it holds.
+		static void DeleteResult(BMessage *message);
 	
 		// Remembers, and possibly escapes, the search pattern.
 		void SetPattern(const char *src);
@@ -68,26 +214,128 @@ class Grepper {
 		// Determines whether we can grep a file.
 		bool ExamineFile(BEntry &entry, char *buffer);
 	
-		// Contains pointers to BDirectory objects.
+		// Contains pointers to GrepDirectory objects.
 		BList *fDirectories;
 	
 		// The directory we are currently looking at.
-		BDirectory *fCurrentDir;
+		GrepDirectory *fCurrentDir;
 	
 		// The ref number we are currently looking at.
 		int32 fCurrentRef;
 	
+		// The files to search instead of the model's target.
+		BMessage fCandidates;
+		
+		// Whether we only look at fCandidates.
+		bool fNarrowing;
+	
 		// The (escaped) search pattern.
 		char *fPattern;
 		
+		// Looks for literal patterns, so we don't need grep. 
+		// NULL if the pattern is a regular expression.
+		Matcher *fMatcher;
+		
+		// The pattern, when we match a regular expression across 
+		// lines ourselves. Otherwise NULL, and grep does it.
+		regex_t *fRegex;
+		
+		// The words of a boolean query, and the automaton that looks
+		// for all of them at once. NULL if this is a normal search.
+		Query *fQuery;
+		MultiMatcher *fWords;
+		
+		// Looks for plain text with typos. NULL unless we allow those.
+		FuzzyMatcher *fFuzzy;
+		
 		// The directory or files to grep on.
 		Model *fModel;
 	    
 		// Our thread's ID.
 		thread_id fThreadId;
+		
+		// Contains pointers to GrepWorker objects.
+		BList *fWorkers;
+		
+		// The results that the window hasn't picked up yet.
+		ResultQueue *fResults;
+		
+		// Counts the free slots in fResults.
+		sem_id fQueueSem;
+		
+		// Whether we leave the text of matching lines out of the 
+		// results, so the window reads it when it needs it.
+		bool fLazyText;
+		
+		// Whether ReadResult() hands out the results in the order
+		// in which the files were found.
+		bool fOrdered;
+		
+		// The sequence number for the next file we hand out.
+		int32 fNextSequence;
+		
+		// The sequence number of the next file whose results
+		// ReadResult() may hand out.
+		int32 fNextRelease;
+		
+		struct ReorderSlot {
+			bool arrived;
+			BMessage *message;
+		};
+		
+		// Holds results that came in before those of earlier files,
+		// indexed by sequence number. Workers may not get further 
+		// ahead of fNextRelease than fits in here.
+		ReorderSlot *fReorder;
+		
+		// How many slots in fReorder have arrived.
+		int32 fReorderCount;
+		
+		// Counts the sequence numbers that NextFile() may still 
+		// hand out before it overflows fReorder.
+		sem_id fReorderSem;
+		
+		// Whether all the workers have exited. 
+		volatile bool fWorkersDone;
 	
-		// Whether our thread must quit.
-		bool fMustQuit;
+		// Whether our thread must quit. This is checked
+		// while scanning a file, not just between files.
+		volatile bool fMustQuit;
+		
+		// Whether the workers stopped at the result limit.
+		bool fPaused;
+		
+		// The files (strdup'ed path names) the workers were
+		// searching when the user cancelled; they must be 
+		// searched again when we resume.
+		BList *fPendingFiles;
+		
+		// Protects fPendingFiles and the directory traversal,
+		// which the workers share.
+		BLocker fPendingLock;
+		
+		// Protects the workers' grepTeam, and makes sure that 
+		// Cancel() and a worker that starts grep don't miss 
+		// each other.
+		BLocker fTeamLock;
+		
+		// How many files we have grepped so far.
+		int32 fFilesDone;
+		
+		// How many bytes we have searched so far.
+		int64 fBytesDone;
+		
+		// The file we are searching right now.
+		BString fCurrentFile;
+		
+		// Protects fCurrentFile.
+		BLocker fProgressLock;
+		
+		// How many results we have reported so far.
+		int32 fResultCount;
+		
+		// When fResultCount gets here, we pause the search.
+		int32 fResultLimit;
 };
 
 #endif // __GREPPER_H__
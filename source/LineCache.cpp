@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <Path.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LineCache.h"
+
+#define LINE_CACHE_PAGES      32
+#define LINE_CACHE_PAGE_SIZE  (16 * 1024)
+
+
+LineCache::LineCache()
+{
+	fPages = new Page[LINE_CACHE_PAGES];
+	for (int32 t = 0; t < LINE_CACHE_PAGES; ++t) {
+		fPages[t].file = -1;
+		fPages[t].data = NULL;
+	}
+
+	fUseCount = 0;
+	fFile = -1;
+	fFD = -1;
+}
+
+
+LineCache::~LineCache()
+{
+	MakeEmpty();
+
+	for (int32 t = 0; t < LINE_CACHE_PAGES; ++t)
+		free(fPages[t].data);
+	delete[] fPages;
+}
+
+
+void LineCache::MakeEmpty()
+{
+	for (int32 t = 0; t < LINE_CACHE_PAGES; ++t)
+		fPages[t].file = -1;
+
+	if (fFD >= 0)
+		close(fFD);
+
+	fFile = -1;
+	fFD = -1;
+}
+
+
+int32 LineCache::Read(int32 file, const entry_ref *ref, off_t offset,
+	char *buffer, int32 length)
+{
+	int32 done = 0;
+
+	// A line may cross the end of a page.
+
+	while (done < length) {
+		off_t index = (offset + done) / LINE_CACHE_PAGE_SIZE;
+		Page *page = GetPage(file, ref, index);
+		if (page == NULL)
+			break;
+
+		int32 start = (offset + done) - index * LINE_CACHE_PAGE_SIZE;
+		int32 size = page->size - start;
+		if (size <= 0)
+			break;
+		if (size > length - done)
+			size = length - done;
+
+		memcpy(buffer + done, page->data + start, size);
+		done += size;
+	}
+
+	return done;
+}
+
+
+LineCache::Page *LineCache::GetPage(int32 file, const entry_ref *ref, 
+	off_t index)
+{
+	Page *oldest = &fPages[0];
+
+	for (int32 t = 0; t < LINE_CACHE_PAGES; ++t) {
+		Page *page = &fPages[t];
+		if (page->file == file && page->index == index) {
+			page->lastUse = ++fUseCount;
+			return page;
+		}
+
+		if (page->file < 0 || (oldest->file >= 0 
+				&& page->lastUse < oldest->lastUse))
+			oldest = page;
+	}
+
+	if (file != fFile) {
+		if (fFD >= 0)
+			close(fFD);
+
+		fFile = file;
+		BPath path(ref);
+		fFD = (path.InitCheck() == B_OK) ? open(path.Path(), O_RDONLY) : -1;
+	}
+
+	if (fFD < 0)
+		return NULL;
+
+	if (oldest->data == NULL) {
+		oldest->data = (char*) malloc(LINE_CACHE_PAGE_SIZE);
+		if (oldest->data == NULL)
+			return NULL;
+	}
+
+	ssize_t size = pread(fFD, oldest->data, LINE_CACHE_PAGE_SIZE, 
+		index * LINE_CACHE_PAGE_SIZE);
+	if (size < 0)
+		return NULL;
+
+	oldest->file = file;
+	oldest->index = index;
+	oldest->size = size;
+	oldest->lastUse = ++fUseCount;
+	return oldest;
+}
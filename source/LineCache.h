@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __LINE_CACHE_H__
+#define __LINE_CACHE_H__
+
+#include <Entry.h>
+
+// Reads the text of matching lines from the files themselves, for
+// results that only know where their lines are. Keeps the pages it 
+// read most recently, because the rows on screen usually come from 
+// the same few places.
+class LineCache {
+	public:
+	
+		LineCache();
+		virtual ~LineCache();
+		
+		// Forgets all pages and closes the file.
+		void MakeEmpty();
+		
+		// Copies "length" bytes, starting at "offset" in the file 
+		// that "ref" points to, into "buffer". "file" tells files
+		// apart in the cache. Returns how many bytes it copied,
+		// which is less than "length" if the file got shorter.
+		int32 Read(int32 file, const entry_ref *ref, off_t offset, 
+			char *buffer, int32 length);
+	
+	private:
+	
+		struct Page {
+			int32 file;         // -1 if not used
+			off_t index;
+			int32 size;
+			uint32 lastUse;
+			char *data;
+		};
+		
+		// Returns the page, reading it if we don't have it.
+		Page *GetPage(int32 file, const entry_ref *ref, off_t index);
+		
+		Page *fPages;
+		uint32 fUseCount;
+		
+		// The file we have open, and its descriptor.
+		int32 fFile;
+		int fFD;
+};
+
+#endif // __LINE_CACHE_H__
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CaseFold.h"
+#include "Matcher.h"
+
+
+Matcher::Matcher(const char *pattern, bool caseSensitive, bool utf8)
+{
+	for (int32 c = 0; c < 256; ++c) {
+		if (!caseSensitive && c >= 'A' && c <= 'Z')
+			fFold[c] = c + ('a' - 'A');
+		else
+			fFold[c] = c;
+	}
+
+	fLength = strlen(pattern);
+	fPattern = (uchar*) malloc(fLength + 1);
+	fSets = NULL;
+
+	for (int32 c = 0; c < 256; ++c)
+		fSkip[c] = fLength;
+
+	// Only text with non-ASCII characters needs Unicode folding;
+	// everything else stays on the fast path.
+
+	bool unicode = false;
+	for (int32 t = 0; t < fLength && !caseSensitive && utf8; ++t) {
+		if ((uchar) pattern[t] >= 0x80)
+			unicode = true;
+	}
+
+	if (unicode) {
+		const uchar *src = (const uchar*) pattern;
+		fSets = (uchar*) calloc(fLength, 32);
+
+		for (int32 pos = 0; pos < fLength; ) {
+			uint32 c;
+			int32 length = decode_utf8(src + pos, src + fLength, &c);
+			if (length == 0) {
+				fPattern[pos] = src[pos];
+				fSets[pos * 32 + (src[pos] >> 3)] |= 1 << (src[pos] & 7);
+				++pos;
+				continue;
+			}
+
+			uint32 variants[MAX_CASE_VARIANTS];
+			int32 count = case_variants(c, variants);
+			for (int32 t = 0; t < count; ++t) {
+				uchar bytes[4];
+				encode_utf8(variants[t], bytes);
+				for (int32 i = 0; i < length; ++i) {
+					fSets[(pos + i) * 32 + (bytes[i] >> 3)] 
+						|= 1 << (bytes[i] & 7);
+				}
+			}
+
+			encode_utf8(fold_char(c), fPattern + pos);
+			pos += length;
+		}
+		fPattern[fLength] = '\0';
+
+		for (int32 t = 0; t < fLength - 1; ++t) {
+			for (int32 c = 0; c < 256; ++c) {
+				if (InSet(t, c))
+					fSkip[c] = fLength - 1 - t;
+			}
+		}
+		return;
+	}
+
+	for (int32 t = 0; t <= fLength; ++t)
+		fPattern[t] = fFold[(uchar) pattern[t]];
+
+	// The skip table is indexed with the raw text bytes, so both 
+	// cases of a letter get the same entry if we ignore case.
+
+	for (int32 t = 0; t < fLength - 1; ++t) {
+		for (int32 c = 0; c < 256; ++c) {
+			if (fFold[c] == fPattern[t])
+				fSkip[c] = fLength - 1 - t;
+		}
+	}
+}
+
+
+Matcher::~Matcher()
+{
+	free(fPattern);
+	free(fSets);
+}
+
+
+const char *Matcher::Find(const char *start, const char *end) const
+{
+	if (fLength == 0)
+		return start;
+	if (fSets != NULL)
+		return FindUnicode(start, end);
+
+	const uchar *text = (const uchar*) start;
+	const uchar *last = (const uchar*) end - fLength;
+	const int32 tail = fLength - 1;
+	const uchar lastChar = fPattern[tail];
+
+	while (text <= last) {
+		uchar c = text[tail];
+
+		if (fFold[c] == lastChar) {
+			int32 t = tail - 1;
+			while (t >= 0 && fFold[text[t]] == fPattern[t])
+				--t;
+			if (t < 0)
+				return (const char*) text;
+		}
+
+		text += fSkip[c];
+	}
+
+	return NULL;
+}
+
+
+const char *Matcher::FindUnicode(const char *start, const char *end) const
+{
+	const uchar *text = (const uchar*) start;
+	const uchar *last = (const uchar*) end - fLength;
+	const int32 tail = fLength - 1;
+
+	while (text <= last) {
+		uchar c = text[tail];
+
+		if (InSet(tail, c)) {
+			int32 t = tail - 1;
+			while (t >= 0 && InSet(t, text[t]))
+				--t;
+			if (t < 0 && Verify(text))
+				return (const char*) text;
+		}
+
+		text += fSkip[c];
+	}
+
+	return NULL;
+}
+
+
+inline bool Matcher::InSet(int32 pos, uchar c) const
+{
+	return (fSets[pos * 32 + (c >> 3)] & (1 << (c & 7))) != 0;
+}
+
+
+bool Matcher::Verify(const uchar *text) const
+{
+	uchar folded[4];
+	for (int32 pos = 0; pos < fLength; ) {
+		int32 length = fold_utf8(text + pos, text + fLength, folded);
+		if (memcmp(folded, fPattern + pos, length) != 0)
+			return false;
+		pos += length;
+	}
+	return true;
+}
+
+
+int32 Matcher::Length() const
+{
+	return fLength;
+}
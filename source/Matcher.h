@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __MATCHER_H__
+#define __MATCHER_H__
+
+#include <SupportDefs.h>
+
+// Finds a literal string in a block of text, using Boyer-Moore-Horspool.
+// Case-insensitive matching of ASCII patterns only folds ASCII letters, 
+// which also works for text in other encodings that are a superset of 
+// ASCII. Other patterns are taken to be UTF-8, and folded with the 
+// rules in CaseFold.h.
+class Matcher {
+	public:
+	
+		// If the text isn't UTF-8, pass false for "utf8", and 
+		// we only fold ASCII letters.
+		Matcher(const char *pattern, bool caseSensitive, bool utf8 = true);
+		virtual ~Matcher();
+		
+		// Returns the first occurrence of the pattern that lies 
+		// entirely within "start" and "end", or NULL if there is 
+		// none. An empty pattern matches at "start".
+		const char *Find(const char *start, const char *end) const;
+		
+		// Returns the length of the pattern in bytes.
+		int32 Length() const;
+	
+	private:
+	
+		// Find() for patterns with non-ASCII characters, 
+		// when we ignore case.
+		const char *FindUnicode(const char *start, const char *end) const;
+		
+		// Whether the byte "c" can be at "pos" in a match.
+		bool InSet(int32 pos, uchar c) const;
+		
+		// Whether the text at "text" folds into the pattern.
+		bool Verify(const uchar *text) const;
+		
+		// The pattern, already folded if we ignore case.
+		uchar *fPattern;
+		
+		// The length of fPattern.
+		int32 fLength;
+		
+		// Maps every byte onto itself, or onto its lowercase 
+		// variant if we ignore case.
+		uchar fFold[256];
+		
+		// How far we may move ahead when we see a certain byte
+		// at the end of the current window.
+		int32 fSkip[256];
+		
+		// For FindUnicode(): the bytes that each position of a match
+		// may have, 32 bytes of bits per position. The bytes of the 
+		// case variants of a character are allowed independently, so
+		// a candidate still needs to be verified.
+		uchar *fSets;
+};
+
+#endif // __MATCHER_H__
@@ -25,6 +25,7 @@
 #include <Path.h>
 #include <Directory.h>
 #include <File.h>
+#include <fs_attr.h>
 #include <List.h>
 #include <MenuItem.h>
 
@@ -40,10 +41,21 @@ Model::Model()
 	fRecurseDirs = true;
 	fRecurseLinks = false;
 	fCaseSensitive = false;
+	fWholeWord = false;
 	fEscapeText = true;
 	fTextOnly = true;
 	fInvokePe = false;
+	fLiveSearch = false;
+	fOrderedResults = false;
+	fLazyText = false;
+	fMultiLine = false;
+	fBooleanQuery = false;
 	fShowContents = false;
+	fResultMode = RESULTS_LINES;
+	fMaxResults = 0;
+	fContextLines = 0;
+	fMaxErrors = 0;
+	fMaxPerFile = 0;
 	fSkipDotDirs = true;
 
 	fTarget = NULL;
@@ -92,6 +104,9 @@ status_t Model::LoadPrefs()
 	if (file.ReadAttr("CaseSensitive", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
 		fCaseSensitive = (value != 0);
 
+	if (file.ReadAttr("WholeWord", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fWholeWord = (value != 0);
+
 	if (file.ReadAttr("EscapeText", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
 		fEscapeText = (value != 0);
 
@@ -101,9 +116,43 @@ status_t Model::LoadPrefs()
 	if (file.ReadAttr("InvokePe", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
 		fInvokePe = (value != 0);
 
+	if (file.ReadAttr("LiveSearch", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fLiveSearch = (value != 0);
+
+	if (file.ReadAttr("OrderedResults", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fOrderedResults = (value != 0);
+
+	if (file.ReadAttr("LazyText", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fLazyText = (value != 0);
+
+	if (file.ReadAttr("MultiLine", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fMultiLine = (value != 0);
+
+	if (file.ReadAttr("BooleanQuery", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fBooleanQuery = (value != 0);
+
 	if (file.ReadAttr("ShowContents", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
 		fShowContents = (value != 0);
 
+	if (file.ReadAttr("ResultMode", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0) {
+		if (value == RESULTS_FILES || value == RESULTS_COUNT)
+			fResultMode = (result_mode_t) value;
+		else
+			fResultMode = RESULTS_LINES;
+	}
+
+	if (file.ReadAttr("MaxResults", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fMaxResults = (value > 0) ? value : 0;
+
+	if (file.ReadAttr("MaxPerFile", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fMaxPerFile = (value > 0) ? value : 0;
+
+	if (file.ReadAttr("ContextLines", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fContextLines = (value > 0) ? value : 0;
+
+	if (file.ReadAttr("MaxErrors", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
+		fMaxErrors = (value > 0) ? value : 0;
+
 	char buffer [B_PATH_NAME_LENGTH+1];
 	int32 length = file.ReadAttr("FilePanelPath", B_STRING_TYPE, 0, &buffer, sizeof(buffer));
 	if (length > 0) {
@@ -116,6 +165,16 @@ status_t Model::LoadPrefs()
 	if (file.ReadAttr("Encoding", B_INT32_TYPE, 0, &value, sizeof(int32)) > 0)
 		fEncoding = value;
 
+	attr_info info;
+	if (file.GetAttrInfo("ResumeState", &info) == B_OK
+		&& info.type == B_MESSAGE_TYPE && info.size > 0) {
+		char *flat = new char[info.size];
+		if (file.ReadAttr("ResumeState", B_MESSAGE_TYPE, 0, flat, info.size) 
+				== info.size)
+			fResumeState.Unflatten(flat);
+		delete[] flat;
+	}
+
 	file.Unlock();
 	
 	return B_OK;
@@ -149,6 +208,9 @@ status_t Model::SavePrefs()
 
 	value = fCaseSensitive ? 1 : 0;
 	file.WriteAttr("CaseSensitive", B_INT32_TYPE, 0, &value, sizeof(int32));
+	
+	value = fWholeWord ? 1 : 0;
+	file.WriteAttr("WholeWord", B_INT32_TYPE, 0, &value, sizeof(int32));
 
 	value = fEscapeText ? 1 : 0;
 	file.WriteAttr("EscapeText", B_INT32_TYPE, 0, &value, sizeof(int32));
@@ -159,15 +221,50 @@ status_t Model::SavePrefs()
 	value = fInvokePe ? 1 : 0;
 	file.WriteAttr("InvokePe", B_INT32_TYPE, 0, &value, sizeof(int32));
 	
+	value = fLiveSearch ? 1 : 0;
+	file.WriteAttr("LiveSearch", B_INT32_TYPE, 0, &value, sizeof(int32));
+	
+	value = fOrderedResults ? 1 : 0;
+	file.WriteAttr("OrderedResults", B_INT32_TYPE, 0, &value, sizeof(int32));
+	
+	value = fLazyText ? 1 : 0;
+	file.WriteAttr("LazyText", B_INT32_TYPE, 0, &value, sizeof(int32));
+	
+	value = fMultiLine ? 1 : 0;
+	file.WriteAttr("MultiLine", B_INT32_TYPE, 0, &value, sizeof(int32));
+	
+	value = fBooleanQuery ? 1 : 0;
+	file.WriteAttr("BooleanQuery", B_INT32_TYPE, 0, &value, sizeof(int32));
+	
 	value = fShowContents ? 1 : 0;
 	file.WriteAttr("ShowContents", B_INT32_TYPE, 0, &value, sizeof(int32));
 	
+	value = fResultMode;
+	file.WriteAttr("ResultMode", B_INT32_TYPE, 0, &value, sizeof(int32));
+	
+	file.WriteAttr("MaxResults", B_INT32_TYPE, 0, &fMaxResults, sizeof(int32));
+	
+	file.WriteAttr("MaxPerFile", B_INT32_TYPE, 0, &fMaxPerFile, sizeof(int32));
+	
+	file.WriteAttr("ContextLines", B_INT32_TYPE, 0, &fContextLines, sizeof(int32));
+	file.WriteAttr("MaxErrors", B_INT32_TYPE, 0, &fMaxErrors, sizeof(int32));
+	
 	file.WriteAttr("WindowFrame", B_RECT_TYPE, 0, &fFrame, sizeof(BRect));
 	
 	file.WriteAttr("FilePanelPath", B_STRING_TYPE, 0, fFilePanelPath.String(), fFilePanelPath.Length()+1);
 
 	file.WriteAttr("Encoding", B_INT32_TYPE, 0, &fEncoding, sizeof(int32));
 
+	if (fResumeState.IsEmpty())
+		file.RemoveAttr("ResumeState");
+	else {
+		ssize_t size = fResumeState.FlattenedSize();
+		char *flat = new char[size];
+		if (fResumeState.Flatten(flat, size) == B_OK)
+			file.WriteAttr("ResumeState", B_MESSAGE_TYPE, 0, flat, size);
+		delete[] flat;
+	}
+
 	file.Sync();
 	file.Unlock();
 
@@ -175,6 +272,64 @@ status_t Model::SavePrefs()
 }
 
 
+void Model::SaveOptions(BMessage *message)
+{
+	message->AddBool("RecurseDirs", fRecurseDirs);
+	message->AddBool("RecurseLinks", fRecurseLinks);
+	message->AddBool("SkipDotDirs", fSkipDotDirs);
+	message->AddBool("CaseSensitive", fCaseSensitive);
+	message->AddBool("WholeWord", fWholeWord);
+	message->AddBool("EscapeText", fEscapeText);
+	message->AddBool("MultiLine", fMultiLine);
+	message->AddBool("BooleanQuery", fBooleanQuery);
+	message->AddBool("TextOnly", fTextOnly);
+	message->AddInt32("ResultMode", (int32) fResultMode);
+	message->AddInt32("MaxPerFile", fMaxPerFile);
+	message->AddInt32("ContextLines", fContextLines);
+	message->AddInt32("MaxErrors", fMaxErrors);
+	message->AddInt32("Encoding", (int32) fEncoding);
+}
+
+
+void Model::RestoreOptions(const BMessage *message)
+{
+	// Fields that are missing (from a state saved by an older 
+	// version) leave the current setting alone.
+
+	bool flag;
+	int32 value;
+
+	if (message->FindBool("RecurseDirs", &flag) == B_OK)
+		fRecurseDirs = flag;
+	if (message->FindBool("RecurseLinks", &flag) == B_OK)
+		fRecurseLinks = flag;
+	if (message->FindBool("SkipDotDirs", &flag) == B_OK)
+		fSkipDotDirs = flag;
+	if (message->FindBool("CaseSensitive", &flag) == B_OK)
+		fCaseSensitive = flag;
+	if (message->FindBool("WholeWord", &flag) == B_OK)
+		fWholeWord = flag;
+	if (message->FindBool("EscapeText", &flag) == B_OK)
+		fEscapeText = flag;
+	if (message->FindBool("MultiLine", &flag) == B_OK)
+		fMultiLine = flag;
+	if (message->FindBool("BooleanQuery", &flag) == B_OK)
+		fBooleanQuery = flag;
+	if (message->FindBool("TextOnly", &flag) == B_OK)
+		fTextOnly = flag;
+	if (message->FindInt32("ResultMode", &value) == B_OK)
+		fResultMode = (result_mode_t) value;
+	if (message->FindInt32("MaxPerFile", &value) == B_OK)
+		fMaxPerFile = value;
+	if (message->FindInt32("ContextLines", &value) == B_OK)
+		fContextLines = value;
+	if (message->FindInt32("MaxErrors", &value) == B_OK)
+		fMaxErrors = value;
+	if (message->FindInt32("Encoding", &value) == B_OK)
+		fEncoding = (uint32) value;
+}
+
+
 void Model::AddToHistory(const char *text) 
 {
 	BList *items = LoadHistory();
@@ -36,6 +36,18 @@
 #define PREFS_FILE    "TrackerGrepSettings"
 #define HISTORY_LIMIT  20
 
+// How long to wait after the last keystroke before searching.
+#define LIVE_SEARCH_DELAY  300000
+
+// How often the window picks up new results while searching: about 
+// once per frame. It spends no more than RESULT_FRAME_BUDGET on them
+// each time, so scrolling and typing don't have to wait.
+#define SEARCH_TIMER_INTERVAL  20000
+#define RESULT_FRAME_BUDGET  8000
+
+// How often the window shows how far the search has come.
+#define PROGRESS_INTERVAL  100000
+
 #define TRACKER_SIGNATURE  "application/x-vnd.Be-TRAK"
 #define PE_SIGNATURE  "application/x-vnd.beunited.pe"
 
@@ -46,19 +58,32 @@ enum
 	MSG_RECURSE_DIRS,
 	MSG_SKIP_DOT_DIRS,
 	MSG_CASE_SENSITIVE,
+	MSG_WHOLE_WORD,
 	MSG_ESCAPE_TEXT,
 	MSG_TEXT_ONLY,
 	MSG_INVOKE_PE,
+	MSG_LIVE_SEARCH,
+	MSG_ORDERED_RESULTS,
+	MSG_LAZY_TEXT,
+	MSG_MULTI_LINE,
+	MSG_BOOLEAN_QUERY,
 	MSG_MENU_SHOW_LINES,
 	MSG_CHECKBOX_SHOW_LINES,
+	MSG_RESULT_MODE,
+	MSG_MAX_RESULTS,
+	MSG_MAX_PER_FILE,
+	MSG_CONTEXT_LINES,
+	MSG_MAX_ERRORS,
 	MSG_SEARCH_TEXT,
 	MSG_INVOKE_ITEM,
 	MSG_SELECT_HISTORY,
+	MSG_LIVE_SEARCH_TIMER,
 
-	MSG_REPORT_FILE_NAME,
+	MSG_SEARCH_TIMER,
 	MSG_REPORT_RESULT,
 	MSG_REPORT_ERROR,
 	MSG_SEARCH_FINISHED,
+	MSG_SEARCH_PAUSED,
 
 	MSG_NEW_WINDOW,
 	MSG_OPEN_PANEL,
@@ -70,7 +95,9 @@ enum
 	MSG_COPY_TEXT,
 	MSG_SELECT_IN_TRACKER,
 	MSG_SELECT_ALL,
-	MSG_OPEN_SELECTION
+	MSG_OPEN_SELECTION,
+	MSG_LOAD_MORE,
+	MSG_RESUME_SEARCH
 };
 
 enum state_t
@@ -80,6 +107,20 @@ enum state_t
 	STATE_CANCEL
 };
 
+enum result_mode_t
+{
+	RESULTS_LINES = 0,
+	RESULTS_FILES,
+	RESULTS_COUNT
+};
+
+// Where a search pattern matched on a line, in bytes from the 
+// start of the line. Lines are never longer than 64 KB.
+struct MatchRange {
+	uint16 start;
+	uint16 length;
+};
+
 class Model {
 	public:
 	
@@ -88,6 +129,12 @@ class Model {
 		status_t LoadPrefs();
 		status_t SavePrefs();
 	
+		// Copies the options that decide what a search finds to or
+		// from a message, so a cancelled search can be resumed with
+		// exactly the settings it was started with.
+		void SaveOptions(BMessage *message);
+		void RestoreOptions(const BMessage *message);
+	
 		void AddToHistory(const char *text);
 		void FillHistoryMenu(BMenu *menu);
 	
@@ -108,18 +155,59 @@ class Model {
 		
 		// Whether the search is case sensitive.
 		bool fCaseSensitive;
+		
+		// Whether the pattern only matches whole words.
+		bool fWholeWord;
 	
 		// Whether the search pattern will be escaped.
 		bool fEscapeText;
 		
+		// Whether a "\n" in the pattern matches a line break, so that
+		// matches can span several lines.
+		bool fMultiLine;
+		
+		// Whether escaped search text may combine words with AND, OR
+		// and NOT, to look for files instead of a single string.
+		bool fBooleanQuery;
+		
 		// Whether we look at text files only.
 		bool fTextOnly;
 		
 		// Whether we open the item in Pe and jump to the correct line.
 		bool fInvokePe;
 		
+		// Whether we start searching while the user is still typing.
+		bool fLiveSearch;
+		
+		// Whether results are shown in the order in which the files 
+		// were found, rather than in the order the workers finish them.
+		bool fOrderedResults;
+		
+		// Whether we only remember where the matching lines are,
+		// and read them from the files again when they are shown.
+		bool fLazyText;
+		
 		// Whether to show the contents of matching files.
 		bool fShowContents;
+		
+		// Whether we report matching lines, only the names of the 
+		// matching files, or only the number of matches per file.
+		result_mode_t fResultMode;
+		
+		// How many results we report before pausing the search,
+		// or 0 to keep going until we're done.
+		int32 fMaxResults;
+		
+		// How many matching lines we report per file, or 0 for all.
+		int32 fMaxPerFile;
+		
+		// How many lines before and after each matching line we
+		// show along with it, like grep -C.
+		int32 fContextLines;
+		
+		// How many typos a match of plain text may have, or 0 to 
+		// only find the text exactly.
+		int32 fMaxErrors;
 	
 		// The dimensions of the window.
 		BRect fFrame;
@@ -136,6 +224,10 @@ class Model {
 		// Grep string encoding ?
 		uint32 fEncoding;
 		
+		// The pattern, target and Grepper cursor of the last search
+		// the user cancelled, or empty if there is nothing to resume.
+		BMessage fResumeState;
+		
 	private:
 		BList *LoadHistory();
 		status_t SaveHistory(BList *items);
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CaseFold.h"
+#include "MultiMatcher.h"
+
+
+MultiMatcher::MultiMatcher(bool caseSensitive, bool utf8)
+{
+	fCaseSensitive = caseSensitive;
+	fFoldUnicode = !caseSensitive && utf8;
+
+	for (int32 c = 0; c < 256; ++c) {
+		if (!caseSensitive && c >= 'A' && c <= 'Z')
+			fFold[c] = c + ('a' - 'A');
+		else
+			fFold[c] = c;
+	}
+
+	fDelta = NULL;
+	fOutput = NULL;
+	fStateCount = 0;
+	fStateCapacity = 0;
+	fPatternCount = 0;
+
+	AddState();
+}
+
+
+MultiMatcher::~MultiMatcher()
+{
+	free(fDelta);
+	free(fOutput);
+}
+
+
+int32 MultiMatcher::AddPattern(const char *pattern)
+{
+	if (fPatternCount == MAX_PATTERNS)
+		return -1;
+
+	int32 length = strlen(pattern);
+	const uchar *text = (const uchar*) pattern;
+
+	int32 state = 0;
+	for (int32 pos = 0; pos < length; ) {
+		// Folding keeps the length of each character the same.
+		uchar folded[4];
+		int32 count = 1;
+		if (fFoldUnicode)
+			count = fold_utf8(text + pos, text + length, folded);
+		else
+			folded[0] = text[pos];
+
+		for (int32 t = 0; t < count; ++t) {
+			int32 *next = &fDelta[state * 256 + fFold[folded[t]]];
+			if (*next < 0) {
+				int32 added = AddState();
+				next = &fDelta[state * 256 + fFold[folded[t]]];
+				*next = added;
+			}
+			state = *next;
+		}
+		pos += count;
+	}
+
+	fLengths[fPatternCount] = length;
+	fOutput[state] |= (uint32) 1 << fPatternCount;
+	return fPatternCount++;
+}
+
+
+void MultiMatcher::Build()
+{
+	// We go through the trie breadth first, so the failure state 
+	// of a state (the longest suffix that is also in the trie) is 
+	// already done when we get to it. Missing transitions then
+	// become those of the failure state, which turns the trie into
+	// a DFA that never has to look back.
+
+	int32 *fail = (int32*) malloc(fStateCount * sizeof(int32));
+	int32 *queue = (int32*) malloc(fStateCount * sizeof(int32));
+	int32 head = 0;
+	int32 tail = 0;
+
+	for (int32 c = 0; c < 256; ++c) {
+		int32 next = fDelta[c];
+		if (next < 0)
+			fDelta[c] = 0;
+		else {
+			fail[next] = 0;
+			queue[tail++] = next;
+		}
+	}
+
+	while (head < tail) {
+		int32 state = queue[head++];
+		fOutput[state] |= fOutput[fail[state]];
+
+		for (int32 c = 0; c < 256; ++c) {
+			int32 *next = &fDelta[state * 256 + c];
+			int32 fallback = fDelta[fail[state] * 256 + c];
+
+			if (*next < 0)
+				*next = fallback;
+			else {
+				fail[*next] = fallback;
+				queue[tail++] = *next;
+			}
+		}
+	}
+
+	free(fail);
+	free(queue);
+
+	// Both cases of a letter go the same way.
+	if (!fCaseSensitive) {
+		for (int32 state = 0; state < fStateCount; ++state) {
+			for (int32 c = 'A'; c <= 'Z'; ++c)
+				fDelta[state * 256 + c] = fDelta[state * 256 + fFold[c]];
+		}
+	}
+}
+
+
+int32 MultiMatcher::CountPatterns() const
+{
+	return fPatternCount;
+}
+
+
+int32 MultiMatcher::Length(int32 pattern) const
+{
+	return fLengths[pattern];
+}
+
+
+const char *MultiMatcher::Scan(const char *start, const char *end, 
+	int32 *state, uint32 *hits) const
+{
+	const uchar *text = (const uchar*) start;
+	const uchar *stop = (const uchar*) end;
+	int32 current = *state;
+
+	while (text < stop) {
+		uchar c = *text;
+
+		if (c < 0xC0 || !fFoldUnicode) {
+			current = fDelta[current * 256 + c];
+			++text;
+		} else {
+			uchar folded[4];
+			int32 length = fold_utf8(text, stop, folded);
+			for (int32 t = 0; t < length; ++t)
+				current = fDelta[current * 256 + folded[t]];
+			text += length;
+		}
+
+		if (fOutput[current] != 0) {
+			*state = current;
+			*hits = fOutput[current];
+			return (const char*) text;
+		}
+	}
+
+	*state = current;
+	return NULL;
+}
+
+
+int32 MultiMatcher::AddState()
+{
+	if (fStateCount == fStateCapacity) {
+		fStateCapacity = (fStateCapacity == 0) ? 64 : fStateCapacity * 2;
+		fDelta = (int32*) realloc(fDelta, 
+			fStateCapacity * 256 * sizeof(int32));
+		fOutput = (uint32*) realloc(fOutput, 
+			fStateCapacity * sizeof(uint32));
+	}
+
+	int32 state = fStateCount++;
+	for (int32 c = 0; c < 256; ++c)
+		fDelta[state * 256 + c] = -1;
+	fOutput[state] = 0;
+	return state;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __MULTI_MATCHER_H__
+#define __MULTI_MATCHER_H__
+
+#include <SupportDefs.h>
+
+// The most patterns a MultiMatcher can look for.
+#define MAX_PATTERNS 32
+
+// Finds several literal strings at once, in a single pass over the 
+// text, using an Aho-Corasick automaton. When ignoring case, the 
+// patterns are folded up front, and non-ASCII UTF-8 characters in 
+// the text are folded as we go (see CaseFold.h); ASCII letters are 
+// folded by the automaton itself.
+class MultiMatcher {
+	public:
+	
+		// If the text isn't UTF-8, pass false for "utf8", and 
+		// we only fold ASCII letters.
+		MultiMatcher(bool caseSensitive, bool utf8 = true);
+		virtual ~MultiMatcher();
+		
+		// Adds a pattern and returns its index, or -1 if there are 
+		// too many already. Call Build() after adding all of them.
+		int32 AddPattern(const char *pattern);
+		void Build();
+		
+		int32 CountPatterns() const;
+		int32 Length(int32 pattern) const;
+		
+		// Runs the automaton from "state" over the text until one or
+		// more patterns end. Returns the position right after that, 
+		// and sets "hits" to a bit for every pattern that ended there.
+		// Returns NULL at "end". Start with state 0 at the beginning
+		// of the text, and pass the state on to the next call.
+		const char *Scan(const char *start, const char *end, 
+			int32 *state, uint32 *hits) const;
+	
+	private:
+	
+		// Adds a state to the trie and returns its index.
+		int32 AddState();
+		
+		bool fCaseSensitive;
+		
+		// Whether we fold non-ASCII UTF-8 characters.
+		bool fFoldUnicode;
+		
+		// The transitions, 256 per state. Until Build(), only the 
+		// ones of the trie are there; the others are -1.
+		int32 *fDelta;
+		
+		// The patterns that end in a state, one bit each.
+		uint32 *fOutput;
+		
+		int32 fStateCount;
+		int32 fStateCapacity;
+		
+		int32 fLengths[MAX_PATTERNS];
+		int32 fPatternCount;
+		
+		uchar fFold[256];
+};
+
+#endif // __MULTI_MATCHER_H__
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "PathTrie.h"
+
+
+PathTrie::PathTrie()
+{
+	fNodes = NULL;
+	fNodeCapacity = 0;
+	fBuckets = NULL;
+	fBucketCount = 0;
+	fLastPath = NULL;
+
+	MakeEmpty();
+}
+
+
+PathTrie::~PathTrie()
+{
+	free(fNodes);
+	free(fBuckets);
+	free(fLastPath);
+}
+
+
+void PathTrie::MakeEmpty()
+{
+	fNames.MakeEmpty();
+
+	if (fNodeCapacity == 0) {
+		fNodeCapacity = 256;
+		fNodes = (Node*) malloc(fNodeCapacity * sizeof(Node));
+	}
+
+	fNodes[0].parent = -1;
+	fNodes[0].next = -1;
+	fNodes[0].name = "";
+	fNodeCount = 1;
+
+	Rehash(256);
+
+	fLastLength = -1;
+	fLastNode = 0;
+}
+
+
+int32 PathTrie::AddPath(const char *path, int32 length)
+{
+	if (length == fLastLength && memcmp(path, fLastPath, length) == 0)
+		return fLastNode;
+
+	int32 node = 0;
+	const char *pos = path;
+	const char *end = path + length;
+
+	while (pos < end) {
+		if (*pos == '/') {
+			++pos;
+			continue;
+		}
+
+		const char *slash = (const char*) memchr(pos, '/', end - pos);
+		if (slash == NULL)
+			slash = end;
+
+		node = AddChild(node, pos, slash - pos);
+		if (node < 0)
+			return 0;
+
+		pos = slash;
+	}
+
+	char *last = (char*) realloc(fLastPath, length + 1);
+	if (last != NULL) {
+		memcpy(last, path, length);
+		fLastPath = last;
+		fLastLength = length;
+		fLastNode = node;
+	}
+
+	return node;
+}
+
+
+int32 PathTrie::GetPath(int32 node, char *buffer, int32 size) const
+{
+	// We learn the names from the bottom up, so first 
+	// find out how long the path is.
+
+	int32 length = 0;
+	for (int32 t = node; t > 0; t = fNodes[t].parent)
+		length += 1 + strlen(fNodes[t].name);
+
+	if (length >= size) {
+		if (size > 0)
+			buffer[0] = '\0';
+		return 0;
+	}
+
+	buffer[length] = '\0';
+
+	int32 pos = length;
+	for (int32 t = node; t > 0; t = fNodes[t].parent) {
+		int32 nameLength = strlen(fNodes[t].name);
+		pos -= nameLength + 1;
+		buffer[pos] = '/';
+		memcpy(buffer + pos + 1, fNodes[t].name, nameLength);
+	}
+
+	return length;
+}
+
+
+int32 PathTrie::CountNodes() const
+{
+	return fNodeCount;
+}
+
+
+size_t PathTrie::Size() const
+{
+	return fNodeCapacity * sizeof(Node) + fBucketCount * sizeof(int32)
+		+ fNames.Size();
+}
+
+
+uint32 PathTrie::Hash(int32 parent, const char *name, int32 length)
+{
+	// FNV-1a
+	uint32 hash = 2166136261U ^ (uint32) parent;
+	for (int32 t = 0; t < length; ++t) {
+		hash ^= (uchar) name[t];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+
+int32 PathTrie::AddChild(int32 parent, const char *name, int32 length)
+{
+	uint32 hash = Hash(parent, name, length);
+
+	for (int32 t = fBuckets[hash & (fBucketCount - 1)]; t >= 0; 
+			t = fNodes[t].next) {
+		if (fNodes[t].parent == parent 
+				&& strncmp(fNodes[t].name, name, length) == 0
+				&& fNodes[t].name[length] == '\0')
+			return t;
+	}
+
+	if (fNodeCount == fNodeCapacity) {
+		Node *nodes = (Node*) realloc(fNodes, 
+			fNodeCapacity * 2 * sizeof(Node));
+		if (nodes == NULL)
+			return -1;
+		fNodes = nodes;
+		fNodeCapacity *= 2;
+	}
+
+	char *copy = fNames.Allocate(length + 1);
+	if (copy == NULL)
+		return -1;
+	memcpy(copy, name, length);
+	copy[length] = '\0';
+
+	int32 node = fNodeCount++;
+	fNodes[node].parent = parent;
+	fNodes[node].name = copy;
+
+	int32 bucket = hash & (fBucketCount - 1);
+	fNodes[node].next = fBuckets[bucket];
+	fBuckets[bucket] = node;
+
+	if (fNodeCount > fBucketCount)
+		Rehash(fBucketCount * 2);
+
+	return node;
+}
+
+
+void PathTrie::Rehash(int32 bucketCount)
+{
+	int32 *buckets = (int32*) realloc(fBuckets, bucketCount * sizeof(int32));
+	if (buckets == NULL)
+		return;
+
+	fBuckets = buckets;
+	fBucketCount = bucketCount;
+
+	for (int32 t = 0; t < fBucketCount; ++t)
+		fBuckets[t] = -1;
+
+	for (int32 t = 1; t < fNodeCount; ++t) {
+		const char *name = fNodes[t].name;
+		int32 bucket = Hash(fNodes[t].parent, name, strlen(name)) 
+			& (fBucketCount - 1);
+		fNodes[t].next = fBuckets[bucket];
+		fBuckets[bucket] = t;
+	}
+}
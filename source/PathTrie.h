@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __PATH_TRIE_H__
+#define __PATH_TRIE_H__
+
+#include <SupportDefs.h>
+
+#include "TextArena.h"
+
+// Stores directory paths as a tree of names, so that files in the
+// same directory share its path, and directories share the path of 
+// their parent. Each directory is a node with the index of its 
+// parent and its own name. Node 0 is the root, "/".
+class PathTrie {
+	public:
+	
+		PathTrie();
+		virtual ~PathTrie();
+		
+		void MakeEmpty();
+		
+		// Returns the node for a directory, adding it and its 
+		// parents if they aren't in here yet. "length" is the
+		// length of the path, which need not be null-terminated.
+		int32 AddPath(const char *path, int32 length);
+		
+		// Writes the full path of a node into "buffer", and returns
+		// its length. The root is the empty string, and so is a 
+		// path that doesn't fit.
+		int32 GetPath(int32 node, char *buffer, int32 size) const;
+		
+		int32 CountNodes() const;
+		
+		// How much memory the nodes and their names take up.
+		size_t Size() const;
+	
+	private:
+	
+		struct Node {
+			int32 parent;
+			int32 next;         // in the same hash bucket, or -1
+			const char *name;
+		};
+		
+		static uint32 Hash(int32 parent, const char *name, int32 length);
+		
+		// Returns the child of "parent" with this name, 
+		// adding it if it isn't there.
+		int32 AddChild(int32 parent, const char *name, int32 length);
+		
+		void Rehash(int32 bucketCount);
+		
+		Node *fNodes;
+		int32 fNodeCount;
+		int32 fNodeCapacity;
+		
+		// Hash table of nodes by parent and name.
+		int32 *fBuckets;
+		int32 fBucketCount;
+		
+		TextArena fNames;
+		
+		// Files from the same directory tend to come in one after 
+		// the other, so we remember the last directory we added.
+		char *fLastPath;
+		int32 fLastLength;
+		int32 fLastNode;
+};
+
+#endif // __PATH_TRIE_H__
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Query.h"
+
+
+Query::Query(const char *text)
+{
+	// A query never has more nodes than twice the number 
+	// of tokens, which is at most the length of the text.
+
+	fNodes = (Node*) malloc((strlen(text) * 2 + 2) * sizeof(Node));
+	fNodeCount = 0;
+	fTermCount = 0;
+	fPositive = 0;
+
+	fText = text;
+	NextToken();
+	fRoot = ParseOr();
+
+	if (fRoot < 0 || fToken != TOKEN_END) {
+		// Not a valid query; we look for the text as it is.
+		for (int32 t = 0; t < fTermCount; ++t)
+			free(fTerms[t]);
+		fTermCount = 0;
+		fNodeCount = 0;
+		fRoot = AddNode(NODE_TERM, -1, -1, AddTerm(text, strlen(text)));
+	}
+
+	MarkPositive(fRoot, true);
+}
+
+
+Query::~Query()
+{
+	for (int32 t = 0; t < fTermCount; ++t)
+		free(fTerms[t]);
+	free(fNodes);
+}
+
+
+bool Query::IsBoolean() const
+{
+	return fNodes[fRoot].type != NODE_TERM;
+}
+
+
+int32 Query::CountTerms() const
+{
+	return fTermCount;
+}
+
+
+const char *Query::TermAt(int32 index) const
+{
+	return fTerms[index];
+}
+
+
+uint32 Query::PositiveTerms() const
+{
+	return fPositive;
+}
+
+
+int32 Query::Evaluate(uint32 found, bool complete) const
+{
+	return EvaluateNode(fRoot, found, complete);
+}
+
+
+void Query::NextToken()
+{
+	while (*fText == ' ' || *fText == '\t')
+		++fText;
+
+	if (*fText == '\0') {
+		fToken = TOKEN_END;
+		return;
+	}
+
+	if (*fText == '(' || *fText == ')') {
+		fToken = (*fText == '(') ? TOKEN_OPEN : TOKEN_CLOSE;
+		++fText;
+		return;
+	}
+
+	if (*fText == '"') {
+		fWord = ++fText;
+		while (*fText != '\0' && *fText != '"')
+			++fText;
+		fWordLength = fText - fWord;
+		if (*fText == '"')
+			++fText;
+
+		// An empty or unfinished quote doesn't parse.
+		fToken = (fWordLength > 0 && fText[-1] == '"') ? TOKEN_WORD : -1;
+		return;
+	}
+
+	fWord = fText;
+	while (*fText != '\0' && *fText != ' ' && *fText != '\t'
+		&& *fText != '(' && *fText != ')' && *fText != '"')
+		++fText;
+	fWordLength = fText - fWord;
+
+	fToken = TOKEN_WORD;
+	if (fWordLength == 3 && strncmp(fWord, "AND", 3) == 0)
+		fToken = TOKEN_AND;
+	else if (fWordLength == 2 && strncmp(fWord, "OR", 2) == 0)
+		fToken = TOKEN_OR;
+	else if (fWordLength == 3 && strncmp(fWord, "NOT", 3) == 0)
+		fToken = TOKEN_NOT;
+}
+
+
+int32 Query::ParseOr()
+{
+	int32 left = ParseAnd();
+	while (left >= 0 && fToken == TOKEN_OR) {
+		NextToken();
+		int32 right = ParseAnd();
+		left = (right < 0) ? -1 : AddNode(NODE_OR, left, right, -1);
+	}
+	return left;
+}
+
+
+int32 Query::ParseAnd()
+{
+	int32 left = ParseNot();
+	while (left >= 0) {
+		if (fToken == TOKEN_AND)
+			NextToken();
+		else if (fToken != TOKEN_WORD && fToken != TOKEN_NOT 
+				&& fToken != TOKEN_OPEN)
+			break;
+
+		int32 right = ParseNot();
+		left = (right < 0) ? -1 : AddNode(NODE_AND, left, right, -1);
+	}
+	return left;
+}
+
+
+int32 Query::ParseNot()
+{
+	switch (fToken) {
+		case TOKEN_NOT:
+		{
+			NextToken();
+			int32 node = ParseNot();
+			return (node < 0) ? -1 : AddNode(NODE_NOT, node, -1, -1);
+		}
+
+		case TOKEN_OPEN:
+		{
+			NextToken();
+			int32 node = ParseOr();
+			if (node < 0 || fToken != TOKEN_CLOSE)
+				return -1;
+			NextToken();
+			return node;
+		}
+
+		case TOKEN_WORD:
+		{
+			int32 term = AddTerm(fWord, fWordLength);
+			if (term < 0)
+				return -1;
+			NextToken();
+			return AddNode(NODE_TERM, -1, -1, term);
+		}
+	}
+
+	return -1;
+}
+
+
+int32 Query::AddNode(int32 type, int32 left, int32 right, int32 term)
+{
+	Node *node = &fNodes[fNodeCount];
+	node->type = type;
+	node->left = left;
+	node->right = right;
+	node->term = term;
+	return fNodeCount++;
+}
+
+
+int32 Query::AddTerm(const char *word, int32 length)
+{
+	// The same word twice only needs looking for once.
+	for (int32 t = 0; t < fTermCount; ++t) {
+		if (strncmp(fTerms[t], word, length) == 0 
+				&& fTerms[t][length] == '\0')
+			return t;
+	}
+
+	if (fTermCount == MAX_PATTERNS)
+		return -1;
+
+	char *term = (char*) malloc(length + 1);
+	memcpy(term, word, length);
+	term[length] = '\0';
+
+	fTerms[fTermCount] = term;
+	return fTermCount++;
+}
+
+
+void Query::MarkPositive(int32 node, bool positive)
+{
+	switch (fNodes[node].type) {
+		case NODE_TERM:
+			if (positive)
+				fPositive |= (uint32) 1 << fNodes[node].term;
+			break;
+
+		case NODE_NOT:
+			MarkPositive(fNodes[node].left, false);
+			break;
+
+		default:
+			MarkPositive(fNodes[node].left, positive);
+			MarkPositive(fNodes[node].right, positive);
+			break;
+	}
+}
+
+
+int32 Query::EvaluateNode(int32 node, uint32 found, bool complete) const
+{
+	const Node &n = fNodes[node];
+
+	switch (n.type) {
+		case NODE_TERM:
+			if (found & ((uint32) 1 << n.term))
+				return QUERY_TRUE;
+			return complete ? QUERY_FALSE : QUERY_UNKNOWN;
+
+		case NODE_NOT:
+		{
+			int32 value = EvaluateNode(n.left, found, complete);
+			if (value == QUERY_UNKNOWN)
+				return QUERY_UNKNOWN;
+			return (value == QUERY_TRUE) ? QUERY_FALSE : QUERY_TRUE;
+		}
+
+		case NODE_AND:
+		{
+			// Short-circuit: one false side settles it.
+			int32 left = EvaluateNode(n.left, found, complete);
+			if (left == QUERY_FALSE)
+				return QUERY_FALSE;
+			int32 right = EvaluateNode(n.right, found, complete);
+			if (right == QUERY_FALSE)
+				return QUERY_FALSE;
+			return (left == QUERY_TRUE && right == QUERY_TRUE) 
+				? QUERY_TRUE : QUERY_UNKNOWN;
+		}
+
+		case NODE_OR:
+		{
+			int32 left = EvaluateNode(n.left, found, complete);
+			if (left == QUERY_TRUE)
+				return QUERY_TRUE;
+			int32 right = EvaluateNode(n.right, found, complete);
+			if (right == QUERY_TRUE)
+				return QUERY_TRUE;
+			return (left == QUERY_FALSE && right == QUERY_FALSE) 
+				? QUERY_FALSE : QUERY_UNKNOWN;
+		}
+	}
+
+	return QUERY_UNKNOWN;
+}
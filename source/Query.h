@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __QUERY_H__
+#define __QUERY_H__
+
+#include <SupportDefs.h>
+
+#include "MultiMatcher.h"
+
+// What a query says about a file.
+enum {
+	QUERY_FALSE = 0,
+	QUERY_TRUE,
+	QUERY_UNKNOWN
+};
+
+// A search for files by the words they contain, such as 
+// "apple AND (pear OR NOT plum)". The operators are AND, OR and NOT,
+// in capitals; words without an operator in between are ANDed. Put 
+// quotes around words with spaces in them, or to look for an "AND".
+// If the text doesn't parse, the whole of it is one word.
+class Query {
+	public:
+	
+		Query(const char *text);
+		virtual ~Query();
+		
+		// Whether there are operators, or more than one word. 
+		// Otherwise, this is just a plain search.
+		bool IsBoolean() const;
+		
+		int32 CountTerms() const;
+		const char *TermAt(int32 index) const;
+		
+		// The words that don't appear under a NOT, one bit each. 
+		// Those are the ones worth showing in the results.
+		uint32 PositiveTerms() const;
+		
+		// Tells whether a file matches, given the words that we found
+		// in it so far. Until "complete", that is, until we have seen 
+		// the whole file, the words we didn't find may still come, so 
+		// the answer may be QUERY_UNKNOWN.
+		int32 Evaluate(uint32 found, bool complete) const;
+	
+	private:
+	
+		enum {
+			NODE_TERM,
+			NODE_AND,
+			NODE_OR,
+			NODE_NOT
+		};
+		
+		enum {
+			TOKEN_END,
+			TOKEN_WORD,
+			TOKEN_AND,
+			TOKEN_OR,
+			TOKEN_NOT,
+			TOKEN_OPEN,
+			TOKEN_CLOSE
+		};
+		
+		struct Node {
+			int32 type;
+			int32 left;
+			int32 right;
+			int32 term;
+		};
+		
+		// Reads the next token into fToken, and the word into fWord.
+		void NextToken();
+		
+		// Recursive descent; each returns a node, or -1 on errors.
+		// NOT binds tighter than AND, and AND tighter than OR.
+		int32 ParseOr();
+		int32 ParseAnd();
+		int32 ParseNot();
+		
+		int32 AddNode(int32 type, int32 left, int32 right, int32 term);
+		int32 AddTerm(const char *word, int32 length);
+		
+		void MarkPositive(int32 node, bool positive);
+		
+		int32 EvaluateNode(int32 node, uint32 found, bool complete) const;
+		
+		Node *fNodes;
+		int32 fNodeCount;
+		int32 fRoot;
+		
+		char *fTerms[MAX_PATTERNS];
+		int32 fTermCount;
+		uint32 fPositive;
+		
+		// The parser's position in the text.
+		const char *fText;
+		int32 fToken;
+		const char *fWord;
+		int32 fWordLength;
+};
+
+#endif // __QUERY_H__
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <OS.h>
+
+#include "ResultQueue.h"
+
+
+ResultQueue::ResultQueue(int32 capacity)
+{
+	fSlots = new Slot[capacity];
+	fMask = capacity - 1;
+	fPushPosition = 0;
+	fPopPosition = 0;
+
+	for (int32 t = 0; t < capacity; ++t) {
+		fSlots[t].sequence = t;
+		fSlots[t].message = NULL;
+	}
+}
+
+
+ResultQueue::~ResultQueue()
+{
+	int32 fileSequence;
+	BMessage *message;
+	while (Pop(&fileSequence, &message))
+		delete message;
+
+	delete[] fSlots;
+}
+
+
+bool ResultQueue::Push(int32 fileSequence, BMessage *message)
+{
+	int32 position = atomic_get(&fPushPosition);
+	Slot *slot;
+
+	while (true) {
+		slot = &fSlots[position & fMask];
+		int32 difference = atomic_get(&slot->sequence) - position;
+
+		if (difference == 0) {
+			// The slot is free. Claim it, unless another
+			// producer beat us to it.
+			int32 previous = atomic_test_and_set(
+				&fPushPosition, position + 1, position);
+			if (previous == position)
+				break;
+			position = previous;
+		} else if (difference < 0) {
+			// The consumer hasn't emptied this slot yet.
+			return false;
+		} else {
+			// Another producer already filled it.
+			position = atomic_get(&fPushPosition);
+		}
+	}
+
+	slot->fileSequence = fileSequence;
+	slot->message = message;
+
+	// This publishes the message to the consumer.
+	atomic_set(&slot->sequence, position + 1);
+	return true;
+}
+
+
+bool ResultQueue::Pop(int32 *fileSequence, BMessage **message)
+{
+	Slot *slot = &fSlots[fPopPosition & fMask];
+
+	if (atomic_get(&slot->sequence) - (fPopPosition + 1) < 0)
+		return false;
+
+	*fileSequence = slot->fileSequence;
+	*message = slot->message;
+	slot->message = NULL;
+
+	// Hand the slot back to the producers, one lap further on.
+	atomic_set(&slot->sequence, fPopPosition + fMask + 1);
+	++fPopPosition;
+	return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __RESULT_QUEUE_H__
+#define __RESULT_QUEUE_H__
+
+#include <Message.h>
+
+// A bounded queue of result messages. Any number of threads may push
+// into it at the same time without taking a lock, while one thread 
+// (the window) takes them out. This is Dmitry Vyukov's bounded queue:
+// every slot has a sequence number that tells whether it is free for
+// the producers, or filled and ready for the consumer.
+class ResultQueue {
+	public:
+	
+		// "capacity" must be a power of two.
+		ResultQueue(int32 capacity);
+		virtual ~ResultQueue();
+		
+		// Adds a message, which the queue then owns, together with
+		// the sequence number of its file. The message may be NULL. 
+		// Returns false if the queue is full; the caller should try
+		// again later.
+		bool Push(int32 fileSequence, BMessage *message);
+		
+		// Takes out the oldest message, which the caller must delete.
+		// Returns false if the queue is empty. Only one thread may 
+		// call this.
+		bool Pop(int32 *fileSequence, BMessage **message);
+	
+	private:
+	
+		struct Slot {
+			int32 sequence;
+			int32 fileSequence;
+			BMessage *message;
+		};
+		
+		Slot *fSlots;
+		int32 fMask;
+		
+		// Where the next Push() goes. Producers race for it.
+		int32 fPushPosition;
+		
+		// Where the next Pop() comes from.
+		int32 fPopPosition;
+};
+
+#endif // __RESULT_QUEUE_H__
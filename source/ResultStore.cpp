@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ResultStore.h"
+#include "Sanitize.h"
+
+
+ResultStore::ResultStore()
+{
+	fFiles = NULL;
+	fFileCapacity = 0;
+	fLines = NULL;
+	fLineCapacity = 0;
+	fTree = NULL;
+	fCache = new LineCache();
+	fLineBuffer = NULL;
+	fLineBufferSize = 0;
+	fLabel = (char*) malloc(B_PATH_NAME_LENGTH + 32);
+	fSelection = 1;
+
+	MakeEmpty();
+}
+
+
+ResultStore::~ResultStore()
+{
+	free(fFiles);
+	free(fLines);
+	free(fTree);
+	free(fLineBuffer);
+	free(fLabel);
+	delete fCache;
+}
+
+
+void ResultStore::MakeEmpty()
+{
+	// We keep the memory we already have for the next search.
+	fFileCount = 0;
+	fLineCount = 0;
+	fArena.MakeEmpty();
+	fFolders.MakeEmpty();
+	fCache->MakeEmpty();
+	fRowCount = 0;
+	fSelectedCount = 0;
+}
+
+
+int32 ResultStore::AddFile(const entry_ref *ref, const char *path, 
+	int32 count, bool expanded)
+{
+	int32 file = NewFile(expanded);
+	FileRecord *record = &fFiles[file];
+	record->device = ref->device;
+	record->directory = ref->directory;
+	record->count = count;
+
+	const char *slash = strrchr(path, '/');
+	const char *leaf = (slash != NULL) ? slash + 1 : path;
+	record->folder = (slash != NULL) ? fFolders.AddPath(path, slash - path) : 0;
+	record->leaf = fArena.AddString(leaf);
+
+	// The last part of the path is nearly always the name.
+	if (strcmp(leaf, ref->name) == 0)
+		record->name = record->leaf;
+	else
+		record->name = fArena.AddString(ref->name);
+
+	return file;
+}
+
+
+int32 ResultStore::AddMessage(const char *text)
+{
+	int32 file = NewFile(false);
+	FileRecord *record = &fFiles[file];
+	record->name = NULL;
+	record->leaf = fArena.AddString(text);
+	record->folder = -1;
+	record->count = -1;
+	return file;
+}
+
+
+int32 ResultStore::NewFile(bool expanded)
+{
+	if (fFileCount == fFileCapacity) {
+		fFileCapacity = (fFileCapacity == 0) ? 256 : fFileCapacity * 2;
+		fFiles = (FileRecord*) realloc(fFiles, 
+			fFileCapacity * sizeof(FileRecord));
+		fTree = (int32*) realloc(fTree, 
+			(fFileCapacity + 1) * sizeof(int32));
+	}
+
+	FileRecord *record = &fFiles[fFileCount];
+	record->firstLine = fLineCount;
+	record->lineCount = 0;
+	record->expanded = expanded;
+	record->selection = 0;
+
+	// A new tree node covers itself and the nodes below it 
+	// that its lowest bit spans; those are all complete.
+
+	int32 node = fFileCount + 1;
+	int32 first = node - (node & -node);
+	fTree[node] = 1 + RowsBefore(fFileCount) - RowsBefore(first);
+
+	++fFileCount;
+	++fRowCount;
+	return fFileCount - 1;
+}
+
+
+void ResultStore::AdoptText(char *text, size_t size)
+{
+	fArena.Adopt(text, size);
+}
+
+
+void ResultStore::AddLine(int32 file, int32 number, off_t offset, 
+	const char *text, int32 length, const MatchRange *matches, 
+	int32 matchCount, bool context, int32 distance)
+{
+	if (file != fFileCount - 1)
+		return;
+
+	if (fLineCount == fLineCapacity) {
+		fLineCapacity = (fLineCapacity == 0) ? 1024 : fLineCapacity * 2;
+		fLines = (LineRecord*) realloc(fLines, 
+			fLineCapacity * sizeof(LineRecord));
+	}
+
+	LineRecord *record = &fLines[fLineCount];
+	record->file = file;
+	record->number = number;
+	record->offset = offset;
+	record->text = text;
+	record->matches = matches;
+	record->matchCount = (matches != NULL) ? matchCount : 0;
+	record->context = context;
+	record->distance = distance;
+	record->length = length;
+	record->selection = 0;
+	++fLineCount;
+
+	++fFiles[file].lineCount;
+	if (fFiles[file].expanded)
+		UpdateRows(file, 1);
+}
+
+
+void ResultStore::RemoveLastFile()
+{
+	if (fFileCount == 0)
+		return;
+
+	int32 file = fFileCount - 1;
+	FileRecord *record = &fFiles[file];
+
+	for (int32 t = -1; t < record->lineCount; ++t) {
+		if (IsSelected(file, t))
+			--fSelectedCount;
+	}
+
+	// Its text stays in the arena until we are emptied, but
+	// this is only ever the short message row of a paused search.
+
+	fRowCount -= RowsOf(file);
+	fLineCount = record->firstLine;
+
+	--fFileCount;
+}
+
+
+int32 ResultStore::CountFiles() const
+{
+	return fFileCount;
+}
+
+
+int32 ResultStore::CountLines(int32 file) const
+{
+	return fFiles[file].lineCount;
+}
+
+
+int32 ResultStore::CountRows() const
+{
+	return fRowCount;
+}
+
+
+const char *ResultStore::FileLabel(int32 file)
+{
+	const FileRecord *record = &fFiles[file];
+	if (record->folder < 0)
+		return record->leaf;
+
+	// In "count only" mode we show the number 
+	// of matching lines after the file name.
+
+	int32 length = fFolders.GetPath(record->folder, fLabel, 
+		B_PATH_NAME_LENGTH);
+	snprintf(fLabel + length, B_PATH_NAME_LENGTH + 32 - length, "/%s", 
+		record->leaf);
+
+	if (record->count >= 0) {
+		length = strlen(fLabel);
+		snprintf(fLabel + length, B_PATH_NAME_LENGTH + 32 - length, 
+			" (%ld)", record->count);
+	}
+
+	return fLabel;
+}
+
+
+const char *ResultStore::LineText(int32 file, int32 line, 
+	int32 *length)
+{
+	const LineRecord *record = &fLines[fFiles[file].firstLine + line];
+	if (record->text != NULL) {
+		if (length != NULL)
+			*length = record->length;
+		return record->text;
+	}
+
+	if (record->length + 1 > fLineBufferSize) {
+		char *buffer = (char*) realloc(fLineBuffer, record->length + 1);
+		if (buffer == NULL) {
+			if (length != NULL)
+				*length = 0;
+			return "";
+		}
+		fLineBuffer = buffer;
+		fLineBufferSize = record->length + 1;
+	}
+
+	// If the file has changed since we searched it, this is no 
+	// longer the line that matched, but there's little we can do.
+
+	entry_ref ref;
+	int32 size = 0;
+	if (GetRef(file, &ref)) {
+		size = fCache->Read(file, &ref, record->offset, fLineBuffer, 
+			record->length);
+	}
+
+	sanitize_text(fLineBuffer, fLineBuffer, size);
+	fLineBuffer[size] = '\0';
+	if (length != NULL)
+		*length = size;
+	return fLineBuffer;
+}
+
+
+int32 ResultStore::LineNumber(int32 file, int32 line) const
+{
+	return fLines[fFiles[file].firstLine + line].number;
+}
+
+
+bool ResultStore::IsContext(int32 file, int32 line) const
+{
+	return fLines[fFiles[file].firstLine + line].context;
+}
+
+
+int32 ResultStore::Distance(int32 file, int32 line) const
+{
+	return fLines[fFiles[file].firstLine + line].distance;
+}
+
+
+int32 ResultStore::GetMatches(int32 file, int32 line, 
+	const MatchRange **matches) const
+{
+	const LineRecord *record = &fLines[fFiles[file].firstLine + line];
+	*matches = record->matches;
+	return record->matchCount;
+}
+
+
+off_t ResultStore::LineOffset(int32 file, int32 line) const
+{
+	return fLines[fFiles[file].firstLine + line].offset;
+}
+
+
+bool ResultStore::GetRef(int32 file, entry_ref *ref) const
+{
+	const FileRecord *record = &fFiles[file];
+	if (record->name == NULL)
+		return false;
+
+	ref->device = record->device;
+	ref->directory = record->directory;
+	ref->set_name(record->name);
+	return true;
+}
+
+
+bool ResultStore::GetRow(int32 row, int32 *file, int32 *line) const
+{
+	if (row < 0 || row >= fRowCount)
+		return false;
+
+	// Walk down the tree to the last file that starts at or
+	// before "row".
+
+	int32 node = 0;
+	int32 rest = row;
+	int32 step = 1;
+	while (step * 2 <= fFileCount)
+		step *= 2;
+
+	for (; step > 0; step /= 2) {
+		if (node + step <= fFileCount && fTree[node + step] <= rest) {
+			node += step;
+			rest -= fTree[node];
+		}
+	}
+
+	*file = node;
+	*line = rest - 1;
+	return true;
+}
+
+
+bool ResultStore::NextRow(int32 *file, int32 *line) const
+{
+	if (fFiles[*file].expanded && *line + 1 < fFiles[*file].lineCount) {
+		++*line;
+		return true;
+	}
+
+	if (*file + 1 >= fFileCount)
+		return false;
+
+	++*file;
+	*line = -1;
+	return true;
+}
+
+
+int32 ResultStore::RowOf(int32 file, int32 line) const
+{
+	if (file < 0 || file >= fFileCount)
+		return -1;
+	if (line >= 0 && (!fFiles[file].expanded || line >= fFiles[file].lineCount))
+		return -1;
+
+	return RowsBefore(file) + 1 + line;
+}
+
+
+bool ResultStore::IsExpanded(int32 file) const
+{
+	return fFiles[file].expanded;
+}
+
+
+void ResultStore::SetExpanded(int32 file, bool expanded)
+{
+	FileRecord *record = &fFiles[file];
+	if (record->expanded == expanded)
+		return;
+
+	if (!expanded) {
+		for (int32 t = 0; t < record->lineCount; ++t) {
+			if (IsSelected(file, t)) {
+				SetSelected(file, t, false);
+				SetSelected(file, -1, true);
+			}
+		}
+	}
+
+	record->expanded = expanded;
+	UpdateRows(file, expanded ? record->lineCount : -record->lineCount);
+}
+
+
+void ResultStore::SetAllExpanded(bool expanded)
+{
+	for (int32 t = 0; t < fFileCount; ++t) {
+		FileRecord *record = &fFiles[t];
+		if (record->expanded == expanded)
+			continue;
+
+		if (!expanded) {
+			LineRecord *line = &fLines[record->firstLine];
+			for (int32 i = 0; i < record->lineCount; ++i, ++line) {
+				if (line->selection == fSelection) {
+					line->selection = 0;
+					--fSelectedCount;
+					SetSelected(t, -1, true);
+				}
+			}
+		}
+
+		record->expanded = expanded;
+	}
+
+	RebuildRows();
+}
+
+
+bool ResultStore::IsSelected(int32 file, int32 line) const
+{
+	if (line < 0)
+		return fFiles[file].selection == fSelection;
+	return fLines[fFiles[file].firstLine + line].selection == fSelection;
+}
+
+
+void ResultStore::SetSelected(int32 file, int32 line, bool selected)
+{
+	uint16 *selection;
+	if (line < 0)
+		selection = &fFiles[file].selection;
+	else
+		selection = &fLines[fFiles[file].firstLine + line].selection;
+
+	if ((*selection == fSelection) != selected) {
+		*selection = selected ? fSelection : 0;
+		fSelectedCount += selected ? 1 : -1;
+	}
+}
+
+
+void ResultStore::DeselectAll()
+{
+	fSelectedCount = 0;
+	if (++fSelection != 0)
+		return;
+
+	// Once every 65535 times, the numbers run out and we really
+	// have to clear all the records.
+
+	for (int32 t = 0; t < fFileCount; ++t)
+		fFiles[t].selection = 0;
+	for (int32 t = 0; t < fLineCount; ++t)
+		fLines[t].selection = 0;
+
+	fSelection = 1;
+}
+
+
+int32 ResultStore::CountSelected() const
+{
+	return fSelectedCount;
+}
+
+
+int32 ResultStore::RowsOf(int32 file) const
+{
+	const FileRecord *record = &fFiles[file];
+	return 1 + (record->expanded ? record->lineCount : 0);
+}
+
+
+int32 ResultStore::RowsBefore(int32 file) const
+{
+	int32 rows = 0;
+	for (int32 node = file; node > 0; node -= (node & -node))
+		rows += fTree[node];
+	return rows;
+}
+
+
+void ResultStore::UpdateRows(int32 file, int32 delta)
+{
+	for (int32 node = file + 1; node <= fFileCount; node += (node & -node))
+		fTree[node] += delta;
+	fRowCount += delta;
+}
+
+
+void ResultStore::RebuildRows()
+{
+	// Every node passes its total on to its parent, 
+	// which comes after it, so one pass is enough.
+
+	fRowCount = 0;
+	for (int32 node = 1; node <= fFileCount; ++node) {
+		fTree[node] = RowsOf(node - 1);
+		fRowCount += fTree[node];
+	}
+
+	for (int32 node = 1; node <= fFileCount; ++node) {
+		int32 parent = node + (node & -node);
+		if (parent <= fFileCount)
+			fTree[parent] += fTree[node];
+	}
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __RESULT_STORE_H__
+#define __RESULT_STORE_H__
+
+#include <Entry.h>
+
+#include "Model.h"
+
+#include "LineCache.h"
+#include "PathTrie.h"
+#include "TextArena.h"
+
+// Holds the search results that the list view shows. The results are 
+// a list of files (or messages), each with the lines that matched in 
+// it. Rather than one object per row, we keep a few flat arrays. The
+// text is copied into an arena once, and everyone reads it from there.
+// The directories of the files go into a PathTrie, so we don't store
+// the same directory names over and over.
+//
+// Rows are only the ones you can see: a file, followed by its lines 
+// if it is expanded. To find out which file is at a given row, we 
+// keep a Fenwick tree over the number of rows each file takes up, so 
+// that looking up a row or expanding a file takes O(log n) time.
+class ResultStore {
+	public:
+	
+		ResultStore();
+		virtual ~ResultStore();
+		
+		void MakeEmpty();
+		
+		// Adds a file to the end of the list, and returns its index.
+		// We show the path, followed by the count unless it is -1.
+		int32 AddFile(const entry_ref *ref, const char *path, 
+			int32 count, bool expanded);
+		
+		// Adds a row that is only a message, and returns its index.
+		int32 AddMessage(const char *text);
+		
+		// Takes over a block of text of "size" bytes from malloc, 
+		// which we free when we are emptied.
+		void AdoptText(char *text, size_t size);
+		
+		// Adds a line to a file. This must be the last file. The line 
+		// number is 0 if we don't know it, the offset (of the start of 
+		// the line in the file) is -1. We don't copy the text, so it 
+		// must be in a block we adopted, and must not contain control
+		// characters. If "text" is NULL, we only keep the offset and 
+		// length, and read the text from the file when we need it.
+		// The same goes for "matches", where the pattern matched. 
+		// Context lines are shown around the lines that matched. The
+		// distance is how many typos the best match on the line had.
+		void AddLine(int32 file, int32 number, off_t offset, 
+			const char *text, int32 length, 
+			const MatchRange *matches = NULL, int32 matchCount = 0,
+			bool context = false, int32 distance = 0);
+		
+		// Removes the last file and its lines.
+		void RemoveLastFile();
+		
+		int32 CountFiles() const;
+		int32 CountLines(int32 file) const;
+		int32 CountRows() const;
+		
+		// Puts the label of a file together. It only stays 
+		// good until the next call.
+		const char *FileLabel(int32 file);
+		// The text of a line is null-terminated, but "length" saves 
+		// you from counting. If we had to read it from the file, it 
+		// only stays good until the next call.
+		const char *LineText(int32 file, int32 line, 
+			int32 *length = NULL);
+		int32 LineNumber(int32 file, int32 line) const;
+		bool IsContext(int32 file, int32 line) const;
+		int32 Distance(int32 file, int32 line) const;
+		
+		// Tells where on a line the pattern matched, and 
+		// returns the number of matches.
+		int32 GetMatches(int32 file, int32 line, 
+			const MatchRange **matches) const;
+		off_t LineOffset(int32 file, int32 line) const;
+		
+		// Returns false if the file is only a message.
+		bool GetRef(int32 file, entry_ref *ref) const;
+		
+		// Tells which file, and which of its lines, is at "row". The 
+		// line is -1 for the row of the file itself. Returns false
+		// if there is no such row.
+		bool GetRow(int32 row, int32 *file, int32 *line) const;
+		
+		// Moves on to the row after "file" and "line". Returns
+		// false if that was the last row.
+		bool NextRow(int32 *file, int32 *line) const;
+		
+		// Returns the row of a file or line, or -1 if it is hidden.
+		int32 RowOf(int32 file, int32 line) const;
+		
+		bool IsExpanded(int32 file) const;
+		
+		// Collapsing a file selects it instead of its lines.
+		void SetExpanded(int32 file, bool expanded);
+		
+		// Like calling SetExpanded() for every file, but takes 
+		// O(n) time instead of O(n log n).
+		void SetAllExpanded(bool expanded);
+		
+		bool IsSelected(int32 file, int32 line) const;
+		void SetSelected(int32 file, int32 line, bool selected);
+		
+		// Takes O(1) time, because it only starts a new selection.
+		void DeselectAll();
+		int32 CountSelected() const;
+	
+	private:
+	
+		struct FileRecord {
+			dev_t device;
+			ino_t directory;
+			const char *name;   // NULL if no ref
+			const char *leaf;   // last part of the path, or the message
+			int32 folder;       // node in fFolders
+			int32 count;
+			int32 firstLine;    // index in fLines
+			int32 lineCount;
+			bool expanded;
+			uint16 selection;   // selected if equal to fSelection
+		};
+		
+		struct LineRecord {
+			int32 file;
+			int32 number;
+			off_t offset;
+			const char *text;   // NULL if we read it when needed
+			const MatchRange *matches;
+			int32 length;
+			uint16 matchCount;
+			bool context;
+			uint8 distance;
+			uint16 selection;   // selected if equal to fSelection
+		};
+		
+		// Adds an empty file record.
+		int32 NewFile(bool expanded);
+		
+		// How many rows a file takes up.
+		int32 RowsOf(int32 file) const;
+		
+		// The number of rows before a file.
+		int32 RowsBefore(int32 file) const;
+		
+		// Adds "delta" to the number of rows of a file.
+		void UpdateRows(int32 file, int32 delta);
+		
+		// Builds the Fenwick tree from scratch.
+		void RebuildRows();
+		
+		FileRecord *fFiles;
+		int32 fFileCount;
+		int32 fFileCapacity;
+		
+		LineRecord *fLines;
+		int32 fLineCount;
+		int32 fLineCapacity;
+		
+		TextArena fArena;
+		PathTrie fFolders;
+		char *fLabel;
+		
+		// For lines whose text we didn't keep.
+		LineCache *fCache;
+		char *fLineBuffer;
+		int32 fLineBufferSize;
+		
+		// The Fenwick tree, 1-based, with the rows per file.
+		int32 *fTree;
+		
+		int32 fRowCount;
+		int32 fSelectedCount;
+		
+		// Records that were selected before the last DeselectAll()
+		// still hold an older number, so they no longer count.
+		uint16 fSelection;
+};
+
+#endif // __RESULT_STORE_H__
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Sanitize.h"
+
+
+void sanitize_text(char *dest, const char *src, int32 length)
+{
+	int32 t = 0;
+
+#if defined(__SSE2__)
+	// Sixteen bytes at a time. SSE2 only compares signed bytes, 
+	// so we look for bytes <= 0x1F as those that the unsigned 
+	// maximum with 0x1F leaves alone.
+
+	const __m128i low = _mm_set1_epi8(0x1F);
+	const __m128i del = _mm_set1_epi8(0x7F);
+	const __m128i space = _mm_set1_epi8(' ');
+
+	for (; t + 16 <= length; t += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*) (src + t));
+		__m128i control = _mm_or_si128(
+			_mm_cmpeq_epi8(_mm_max_epu8(bytes, low), low),
+			_mm_cmpeq_epi8(bytes, del));
+		bytes = _mm_or_si128(_mm_andnot_si128(control, bytes),
+			_mm_and_si128(control, space));
+		_mm_storeu_si128((__m128i*) (dest + t), bytes);
+	}
+#else
+	// Without SSE2 we look at four bytes at a time, and only 
+	// bother with the separate bytes if one of them is a control
+	// character. Lines rarely have any.
+
+	for (; t + 4 <= length; t += 4) {
+		uint32 word;
+		memcpy(&word, src + t, 4);
+
+		uint32 below = (word - 0x20202020) & ~word;
+		uint32 isDel = word ^ 0x7F7F7F7F;
+		isDel = (isDel - 0x01010101) & ~isDel;
+
+		if (((below | isDel) & 0x80808080) == 0) {
+			memcpy(dest + t, &word, 4);
+			continue;
+		}
+
+		for (int32 i = t; i < t + 4; ++i) {
+			uchar c = (uchar) src[i];
+			dest[i] = (c < 0x20 || c == 0x7F) ? ' ' : c;
+		}
+	}
+#endif
+
+	for (; t < length; ++t) {
+		uchar c = (uchar) src[t];
+		dest[t] = (c < 0x20 || c == 0x7F) ? ' ' : c;
+	}
+}
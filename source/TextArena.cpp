@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "TextArena.h"
+
+// The size of the blocks we get from malloc. Text that is larger 
+// than this gets a block of its own.
+#define ARENA_BLOCK_SIZE  (256 * 1024)
+
+
+TextArena::TextArena()
+{
+	fFirst = NULL;
+	fPos = NULL;
+	fEnd = NULL;
+	fSize = 0;
+	fStrings = NULL;
+	fStringCapacity = 0;
+	fStringCount = 0;
+}
+
+
+TextArena::~TextArena()
+{
+	for (int32 t = 0; t < fBlocks.CountItems(); ++t)
+		free(fBlocks.ItemAt(t));
+	free(fStrings);
+}
+
+
+void TextArena::MakeEmpty()
+{
+	for (int32 t = 0; t < fBlocks.CountItems(); ++t) {
+		if (fBlocks.ItemAt(t) != fFirst)
+			free(fBlocks.ItemAt(t));
+	}
+	fBlocks.MakeEmpty();
+
+	if (fFirst != NULL) {
+		fBlocks.AddItem(fFirst);
+		fSize = ARENA_BLOCK_SIZE;
+	} else
+		fSize = 0;
+
+	fPos = fFirst;
+	fEnd = (fFirst != NULL) ? fFirst + ARENA_BLOCK_SIZE : NULL;
+
+	// Like the first block, the table stays for the next search.
+	for (int32 t = 0; t < fStringCapacity; ++t)
+		fStrings[t] = NULL;
+	fStringCount = 0;
+}
+
+
+char *TextArena::Allocate(int32 size)
+{
+	if (size > fEnd - fPos) {
+		size_t blockSize = ARENA_BLOCK_SIZE;
+		if ((size_t) size > blockSize)
+			blockSize = size;
+
+		char *block = (char*) malloc(blockSize);
+		if (block == NULL)
+			return NULL;
+
+		fBlocks.AddItem(block);
+		fSize += blockSize;
+
+		// Text that gets a block of its own doesn't make 
+		// us give up the block we were filling.
+		if (blockSize > ARENA_BLOCK_SIZE)
+			return block;
+
+		if (fFirst == NULL)
+			fFirst = block;
+
+		fPos = block;
+		fEnd = block + blockSize;
+	}
+
+	char *result = fPos;
+	fPos += size;
+	return result;
+}
+
+
+const char *TextArena::AddString(const char *text)
+{
+	// We keep the table at most half full, so the runs of 
+	// slots we have to probe stay short.
+
+	if (fStringCount >= fStringCapacity / 2)
+		Rehash((fStringCapacity == 0) ? 256 : fStringCapacity * 2);
+
+	int32 slot = -1;
+	if (fStringCount < fStringCapacity / 2) {
+		int32 mask = fStringCapacity - 1;
+		for (slot = Hash(text) & mask; fStrings[slot] != NULL; 
+				slot = (slot + 1) & mask) {
+			if (strcmp(fStrings[slot], text) == 0)
+				return fStrings[slot];
+		}
+	}
+
+	int32 length = strlen(text) + 1;
+	char *copy = Allocate(length);
+	if (copy == NULL)
+		return NULL;
+
+	memcpy(copy, text, length);
+
+	// If the table couldn't grow, we simply don't share this one.
+	if (slot >= 0) {
+		fStrings[slot] = copy;
+		++fStringCount;
+	}
+
+	return copy;
+}
+
+
+void TextArena::Adopt(char *block, size_t size)
+{
+	fBlocks.AddItem(block);
+	fSize += size;
+}
+
+
+size_t TextArena::Size() const
+{
+	return fSize + fStringCapacity * sizeof(const char*);
+}
+
+
+uint32 TextArena::Hash(const char *text)
+{
+	// FNV-1a
+	uint32 hash = 2166136261U;
+	for (; *text != '\0'; ++text) {
+		hash ^= (uchar) *text;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+
+bool TextArena::Rehash(int32 capacity)
+{
+	const char **strings = (const char**) malloc(
+		capacity * sizeof(const char*));
+	if (strings == NULL)
+		return false;
+
+	for (int32 t = 0; t < capacity; ++t)
+		strings[t] = NULL;
+
+	int32 mask = capacity - 1;
+	for (int32 t = 0; t < fStringCapacity; ++t) {
+		if (fStrings[t] == NULL)
+			continue;
+
+		int32 slot = Hash(fStrings[t]) & mask;
+		while (strings[slot] != NULL)
+			slot = (slot + 1) & mask;
+		strings[slot] = fStrings[t];
+	}
+
+	free(fStrings);
+	fStrings = strings;
+	fStringCapacity = capacity;
+	return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 1998-2007 Matthijs Hollemans
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a 
+ * copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation 
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the 
+ * Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in 
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __TEXT_ARENA_H__
+#define __TEXT_ARENA_H__
+
+#include <List.h>
+#include <SupportDefs.h>
+
+// Hands out memory for text that lives until the end of a search. 
+// The text goes into big blocks that never move, so a pointer into 
+// the arena stays good, and growing it never copies what is already
+// in there. All of it is freed at once by MakeEmpty().
+class TextArena {
+	public:
+	
+		TextArena();
+		virtual ~TextArena();
+		
+		// Throws everything away, but keeps the first 
+		// block around for the next search.
+		void MakeEmpty();
+		
+		// Returns room for "size" bytes.
+		char *Allocate(int32 size);
+		
+		// Copies a string, including its terminating null. If we 
+		// already have the same string, returns that one instead,
+		// because the same file names keep coming back.
+		const char *AddString(const char *text);
+		
+		// Takes over a block of "size" bytes from malloc, to be 
+		// freed with the rest.
+		void Adopt(char *block, size_t size);
+		
+		// How much memory we have taken from the system, 
+		// including the blocks we adopted.
+		size_t Size() const;
+	
+	private:
+	
+		static uint32 Hash(const char *text);
+		
+		// Resizes the string table; returns false if we are out 
+		// of memory.
+		bool Rehash(int32 capacity);
+	
+		BList fBlocks;
+		
+		// The block we keep between searches.
+		char *fFirst;
+		
+		char *fPos;
+		char *fEnd;
+		size_t fSize;
+		
+		// Hash table, with linear probing, of the strings that 
+		// AddString() gave out. Empty slots are NULL.
+		const char **fStrings;
+		int32 fStringCapacity;
+		int32 fStringCount;
+};
+
+#endif // __TEXT_ARENA_H__